@@ -0,0 +1,101 @@
+/*
+*	Desc: Affinity benchmark
+*	Note: Same frame loop with the threads floating & pinned by the topology plan, compares the frame time tail
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "../core/scheduler/workers.hpp"
+#include "../core/scheduler/topology.hpp"
+#include "../core/scheduler/profiling.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace affinity_bench
+	{
+		constexpr auto frameCount{ 1000u };
+		constexpr auto jobsPerFrame{ 64u };
+		constexpr auto jobWork{ std::chrono::microseconds(50) };
+		constexpr auto renderWork{ std::chrono::microseconds(1000) };
+
+		// Burns the time on the clock instead of a fixed amount of work, so a preempted thread shows up as a slow frame
+
+		static std::uint64_t spin(std::chrono::microseconds duration)
+		{
+			const auto end = std::chrono::steady_clock::now() + duration;
+
+			std::uint64_t state{ 0u };
+			while (std::chrono::steady_clock::now() < end)
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+			return state;
+		}
+
+		// Render thread does its share, fans the frame's jobs out & waits on them
+
+		static void runFrames(zkelp::worker_pool_t& pool, zkelp::latency_histogram_t& frames)
+		{
+			for (auto frame = 0u; frame < frameCount; frame++)
+			{
+				const auto start = std::chrono::steady_clock::now();
+
+				zkelp::scheduler_types::job_group_t group;
+				for (auto job = 0u; job < jobsPerFrame; job++)
+					pool.submit([] { spin(jobWork); }, &group);
+
+				spin(renderWork);
+				pool.wait(group, false);
+
+				frames.record(std::chrono::steady_clock::now() - start);
+			}
+		}
+
+		static void logFrames(const char* name, const zkelp::latency_histogram_t& frames)
+		{
+			const auto milli = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1'000'000.0; };
+
+			logger.log("affinity | %-8s frame p50 %.3fms | p99 %.3fms | max %.3fms\n", name, milli(frames.percentile(50.0)), milli(frames.percentile(99.0)), milli(frames.max()));
+		}
+	}
+
+	static void affinityBenchmark()
+	{
+		using namespace affinity_bench;
+
+		zkelp::scheduler_types::affinity_settings_t settings;
+		settings.enabled = true;
+
+		const auto topology = zkelp::topology::read_topology();
+		const auto plan = zkelp::topology::plan(topology, settings);
+		zkelp::topology::log_plan(topology, plan);
+
+		const auto workerCount = static_cast<std::uint32_t>(plan.worker_cpus.size());
+
+		// Floating
+
+		{
+			zkelp::latency_histogram_t frames;
+			zkelp::worker_pool_t pool(workerCount);
+
+			runFrames(pool, frames);
+			logFrames("floating", frames);
+		}
+
+		// Pinned, this thread plays the render thread
+
+		{
+			zkelp::latency_histogram_t frames;
+			zkelp::worker_pool_t pool(workerCount, plan.worker_cpus);
+
+			if (plan.render_cpu.has_value() && !zkelp::topology::pin_current_thread(plan.render_cpu.value()))
+				logger.log("affinity | couldn't pin to cpu %u, the pinned run isn't\n", plan.render_cpu.value());
+
+			runFrames(pool, frames);
+			logFrames("pinned", frames);
+
+			zkelp::topology::unpin_current_thread();
+		}
+	}
+}
\ No newline at end of file
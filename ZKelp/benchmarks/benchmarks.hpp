@@ -0,0 +1,74 @@
+/*
+*	Desc: Benchmark entry
+*	Note: Ran with "--bench <name>" (or "--bench all") instead of starting the engine
+*/
+#pragma once
+#include <string_view>
+
+#include "scheduler.hpp"
+#include "parallel.hpp"
+#include "affinity.hpp"
+#include "frames.hpp"
+#include "memory.hpp"
+#include "textures.hpp"
+#include "pipelines.hpp"
+#include "recording.hpp"
+
+namespace benchmarks
+{
+	static bool run(std::string_view name)
+	{
+		const auto all = name == "all";
+		auto ran{ false };
+
+		if (all || name == "scheduler")
+		{
+			schedulerBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "parallel")
+		{
+			parallelBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "affinity")
+		{
+			affinityBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "inflight")
+		{
+			framesInFlightBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "memory")
+		{
+			memoryBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "textures")
+		{
+			texturesBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "pipelines")
+		{
+			pipelinesBenchmark();
+			ran = true;
+		}
+
+		if (all || name == "recording")
+		{
+			recordingBenchmark();
+			ran = true;
+		}
+
+		return ran;
+	}
+}
\ No newline at end of file
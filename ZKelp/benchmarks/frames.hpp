@@ -0,0 +1,80 @@
+/*
+*	Desc: Frames in flight benchmark
+*	Note: Headless frame loop with a fixed chunk of CPU work per frame, ran with 1 to 3 frames in flight to see how much of the GPU time gets hidden
+*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "../core/scheduler/profiling.hpp"
+#include "../core/rendering/engines/vulkan/vulkan.hpp"
+#include "../utilities/utilFlags.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace frames_bench
+	{
+		constexpr auto frameCount{ 500u };
+		constexpr auto maxInFlight{ 3u };
+		constexpr auto cpuWork{ std::chrono::microseconds(2000) };
+
+		// Stands in for the game & culling side of a frame
+
+		static std::uint64_t spin(std::chrono::microseconds duration)
+		{
+			const auto end = std::chrono::steady_clock::now() + duration;
+
+			std::uint64_t state{ 0u };
+			while (std::chrono::steady_clock::now() < end)
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+			return state;
+		}
+
+		static void runFrames(std::uint32_t inFlight)
+		{
+			utils::framesInFlight = inFlight;
+			vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+
+			zkelp::latency_histogram_t frames;
+			zkelp::latency_histogram_t gpuTimes;
+
+			auto last = std::chrono::steady_clock::now();
+
+			for (auto frame = 0u; frame < frameCount; frame++)
+			{
+				// With a single frame this waits on the whole GPU frame, with more it's usually already done
+
+				const auto gpuTime = vulkan::vulkanEngine.waitFrame(vulkan::vulkanEngine.getCurrentFrame());
+				if (gpuTime.has_value())
+					gpuTimes.record(gpuTime.value());
+
+				spin(cpuWork);
+				vulkan::vulkanEngine.submitOffscreen();
+
+				const auto now = std::chrono::steady_clock::now();
+				frames.record(now - last);
+				last = now;
+			}
+
+			vulkan::vulkanEngine.cleanup(true);
+
+			const auto milli = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1'000'000.0; };
+
+			logger.log("frames | %u in flight | frame p50 %.3fms | p99 %.3fms | max %.3fms | gpu p50 %.3fms\n", inFlight,
+				milli(frames.percentile(50.0)), milli(frames.percentile(99.0)), milli(frames.max()), milli(gpuTimes.percentile(50.0)));
+		}
+	}
+
+	static void framesInFlightBenchmark()
+	{
+		using namespace frames_bench;
+
+		const auto previous = utils::framesInFlight;
+
+		for (auto inFlight = 1u; inFlight <= maxInFlight; inFlight++)
+			runFrames(inFlight);
+
+		utils::framesInFlight = previous;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+*	Desc: Device memory benchmark
+*	Note: Creates 10k textures headless & checks they got sub-allocated, the old path needed a vkAllocateMemory each (past most drivers' 4096 cap)
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "../core/rendering/engines/vulkan/vulkan.hpp"
+#include "../utilities/utilFlags.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace memory_bench
+	{
+		constexpr auto textureCount{ 10'000u };
+		constexpr auto textureSize{ 256u };
+	}
+
+	static void memoryBenchmark()
+	{
+		using namespace memory_bench;
+
+		vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+
+		const auto device = vulkan::vulkanEngine.getDevice();
+
+		std::vector<types::Texture> textures(textureCount);
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (auto& texture : textures)
+			vulkan::createImage(device, textureSize, textureSize, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+
+		const auto created = std::chrono::steady_clock::now();
+
+		const auto stats = vulkan::deviceAllocator.getStats();
+		vulkan::deviceAllocator.logStats();
+
+		for (auto& texture : textures)
+		{
+			vkDestroyImage(device, texture.image, nullptr);
+			vulkan::deviceAllocator.free(texture.memory);
+		}
+
+		const auto freed = std::chrono::steady_clock::now();
+		const auto milli = [](std::chrono::steady_clock::duration time) { return std::chrono::duration<double, std::milli>(time).count(); };
+
+		logger.log("memory | %u textures %ux%u | create %.3fms | free %.3fms | %u vkAllocateMemory at peak (limit %u)\n", textureCount, textureSize, textureSize,
+			milli(created - start), milli(freed - created), stats.peakDeviceAllocations, stats.maxDeviceAllocations);
+
+		vulkan::vulkanEngine.cleanup(true);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*
+*	Desc: Parallel loop benchmark
+*	Note: A big Md multiply & a 10M vertex transform, single thread against parallel_for at different worker counts
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "../core/scheduler/parallel.hpp"
+#include "../core/types/common.hpp"
+#include "../utilities/console/logger.hpp"
+#include "../3rd party/glm/glm.hpp"
+
+namespace benchmarks
+{
+	namespace parallel_bench
+	{
+		constexpr auto matrixSize{ 512u };
+		constexpr auto vertexCount{ 10'000'000u };
+		constexpr auto rowGrain{ 8u };
+		constexpr auto vertexGrain{ 64u * 1024u };
+
+		// Laid out like types::Vertex
+
+		struct BenchVertex
+		{
+			glm::vec3 pos;
+			glm::vec3 color;
+		};
+
+		static auto makeMatrix(double seed)
+		{
+			types::Md matrix(matrixSize, types::Vd(matrixSize));
+
+			for (auto i = 0u; i < matrixSize; i++)
+				for (auto j = 0u; j < matrixSize; j++)
+					matrix[i][j] = seed + static_cast<double>((i * 31u + j * 17u) % 97u) / 97.0;
+			return matrix;
+		}
+
+		// Same product as Md::operator*, one row of the result per index
+
+		static auto parallelProduct(zkelp::worker_pool_t* pool, types::Md& lhs, types::Md& rhs)
+		{
+			types::Md ret(lhs.size(), types::Vd(rhs.size()));
+
+			zkelp::parallel::parallel_for(pool, 0u, lhs.size(), rowGrain, [&](std::size_t begin, std::size_t end) {
+				for (auto i = begin; i < end; i++)
+					for (auto j = 0u; j < rhs.size(); j++)
+						ret[i][j] = std::inner_product(lhs[i].begin(), lhs[i].end(), rhs[j].begin(), 0.0);
+			});
+			return ret;
+		}
+
+		static void transform(std::vector<BenchVertex>& vertices, const glm::mat4& matrix, std::size_t begin, std::size_t end)
+		{
+			for (auto i = begin; i < end; i++)
+				vertices[i].pos = glm::vec3(matrix * glm::vec4(vertices[i].pos, 1.0f));
+		}
+
+		// Sum of every coordinate, just so nothing gets optimized out & the runs can be compared
+
+		static double checksum(zkelp::worker_pool_t* pool, const std::vector<BenchVertex>& vertices)
+		{
+			return zkelp::parallel::parallel_reduce(pool, 0u, vertices.size(), vertexGrain, 0.0,
+				[&](std::size_t begin, std::size_t end) {
+					auto sum{ 0.0 };
+					for (auto i = begin; i < end; i++)
+						sum += vertices[i].pos.x + vertices[i].pos.y + vertices[i].pos.z;
+					return sum;
+				},
+				[](double a, double b) { return a + b; });
+		}
+
+		static auto milliseconds(std::chrono::steady_clock::duration elapsed)
+		{
+			return std::chrono::duration<double, std::milli>(elapsed).count();
+		}
+	}
+
+	static void parallelBenchmark()
+	{
+		using namespace parallel_bench;
+
+		// Matrix product
+
+		auto lhs = makeMatrix(0.5);
+		auto rhs = makeMatrix(1.5);
+
+		auto start = std::chrono::steady_clock::now();
+		const auto expected = lhs * rhs;
+		logger.log("parallel | %ux%u Md::operator* : %.2fms\n", matrixSize, matrixSize, milliseconds(std::chrono::steady_clock::now() - start));
+
+		// Same loop with no pool, so the scaling below only measures the split
+
+		start = std::chrono::steady_clock::now();
+		parallelProduct(nullptr, lhs, rhs);
+		const auto serialProduct = milliseconds(std::chrono::steady_clock::now() - start);
+
+		logger.log("parallel | %ux%u Md multiply, single thread : %.2fms\n", matrixSize, matrixSize, serialProduct);
+
+		for (const auto workerCount : { 1u, 2u, 4u, 8u, 16u })
+		{
+			zkelp::worker_pool_t pool(workerCount);
+
+			start = std::chrono::steady_clock::now();
+			const auto product = parallelProduct(&pool, lhs, rhs);
+			const auto pooled = milliseconds(std::chrono::steady_clock::now() - start);
+
+			logger.log("parallel | %ux%u Md multiply, %2u workers : %.2fms (%.2fx)%s\n", matrixSize, matrixSize, workerCount, pooled, serialProduct / pooled, product == expected ? "" : " MISMATCH");
+		}
+
+		// Vertex transform
+
+		std::vector<BenchVertex> vertices(vertexCount);
+		for (auto i = 0u; i < vertexCount; i++)
+			vertices[i] = { { static_cast<float>(i % 1024u), static_cast<float>(i / 1024u % 1024u), 0.0f }, { 1.0f, 1.0f, 1.0f } };
+
+		const auto original = vertices;
+		const auto matrix = glm::mat4(0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, -1.0f, 0.25f, 1.0f);
+
+		start = std::chrono::steady_clock::now();
+		transform(vertices, matrix, 0u, vertices.size());
+		const auto serialTransform = milliseconds(std::chrono::steady_clock::now() - start);
+		const auto expectedSum = checksum(nullptr, vertices);
+
+		logger.log("parallel | %u vertex transform, single thread : %.2fms\n", vertexCount, serialTransform);
+
+		for (const auto workerCount : { 1u, 2u, 4u, 8u, 16u })
+		{
+			zkelp::worker_pool_t pool(workerCount);
+			vertices = original;
+
+			start = std::chrono::steady_clock::now();
+			zkelp::parallel::parallel_for(&pool, 0u, vertices.size(), vertexGrain, [&](std::size_t begin, std::size_t end) {
+				transform(vertices, matrix, begin, end);
+			});
+			const auto pooled = milliseconds(std::chrono::steady_clock::now() - start);
+
+			logger.log("parallel | %u vertex transform, %2u workers : %.2fms (%.2fx)%s\n", vertexCount, workerCount, pooled, serialTransform / pooled, checksum(&pool, vertices) == expectedSum ? "" : " MISMATCH");
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+/*
+*	Desc: Pipeline cache benchmark
+*	Note: Builds the graphics pipeline cold (empty cache) & warm (reloaded from disk). Drivers keep caches of their own too, so cold may not be fully cold
+*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "../core/rendering/engines/vulkan/vulkan.hpp"
+#include "../utilities/utilFlags.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace pipelines_bench
+	{
+		// Milliseconds to build the engine's pipeline through whatever's in the cache right now
+
+		static double timePipeline()
+		{
+			const auto device = vulkan::vulkanEngine.getDevice();
+
+			const auto start = std::chrono::steady_clock::now();
+			const auto pipelineInfo = vulkan::createRenderingPipeline(device, vulkan::vulkanEngine.getVertexDescriptors(), vulkan::vulkanEngine.getRenderPass());
+			const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			vkDestroyPipeline(device, pipelineInfo->pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineInfo->layout, nullptr);
+			vkDestroyDescriptorSetLayout(device, pipelineInfo->descriptor, nullptr);
+			delete pipelineInfo;
+
+			return elapsed;
+		}
+	}
+
+	static void pipelinesBenchmark()
+	{
+		using namespace pipelines_bench;
+
+		vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+
+		const auto device = vulkan::vulkanEngine.getDevice();
+		const auto physicalDevice = vulkan::vulkanEngine.getPhysicalDevice();
+
+		vulkan::pipelineCache.reset();
+		const auto cold = timePipeline();
+
+		// Round trip through the file like a restart would
+
+		vulkan::pipelineCache.destroy();
+		vulkan::pipelineCache.init(device, physicalDevice, utils::pipelineCachePath);
+		const auto warm = timePipeline();
+
+		logger.log("pipelines | cold %.3fms | warm %.3fms (%zu bytes from disk) | %.2fx\n", cold, warm, vulkan::pipelineCache.loaded(), cold / warm);
+
+		vulkan::vulkanEngine.cleanup(true);
+	}
+}
\ No newline at end of file
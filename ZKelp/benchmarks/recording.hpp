@@ -0,0 +1,95 @@
+/*
+*	Desc: Command recording benchmark
+*	Note: 50k draws recorded into secondary buffers (headless), everything every frame on 1 thread up to every core, then a static scene & one draw changing a frame
+*/
+#pragma once
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "../core/scheduler/profiling.hpp"
+#include "../core/rendering/engines/vulkan/vulkan.hpp"
+#include "../utilities/utilFlags.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace recording_bench
+	{
+		constexpr auto drawCount{ 50'000u };
+		constexpr auto frameCount{ 200u };
+		constexpr auto warmupFrames{ 10u }; // Secondary buffers get allocated on first use, keep that out of it
+
+		// Record + submit time of each frame, change runs before every one of them
+
+		static void runFrames(zkelp::latency_histogram_t& recordTimes, const std::function<void(std::uint32_t)>& change)
+		{
+			for (auto frame = 0u; frame < warmupFrames + frameCount; frame++)
+			{
+				vulkan::vulkanEngine.waitFrame(vulkan::vulkanEngine.getCurrentFrame());
+				change(frame);
+
+				const auto start = std::chrono::steady_clock::now();
+				vulkan::vulkanEngine.submitOffscreen();
+
+				if (frame >= warmupFrames)
+					recordTimes.record(std::chrono::steady_clock::now() - start);
+			}
+		}
+	}
+
+	static void recordingBenchmark()
+	{
+		using namespace recording_bench;
+
+		vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+
+		const std::vector<types::DrawCommand> draws(drawCount);
+		const auto maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		const auto milli = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1'000'000.0; };
+
+		auto singleThread{ 0.0 };
+
+		for (auto threads = 1u; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2u, maxThreads) : threads + 1u)
+		{
+			// The caller records too, so one thread is no pool at all
+
+			std::unique_ptr<zkelp::worker_pool_t> pool;
+			if (threads > 1u)
+				pool = std::make_unique<zkelp::worker_pool_t>(threads - 1u);
+
+			vulkan::vulkanEngine.setDrawList(draws, pool.get());
+
+			zkelp::latency_histogram_t everything;
+			runFrames(everything, [](std::uint32_t) { vulkan::vulkanEngine.getDrawList().invalidate(); });
+
+			const auto median = milli(everything.percentile(50.0));
+			if (threads == 1u)
+				singleThread = median;
+
+			logger.log("recording | %u draws | %2u threads | all buckets p50 %.3fms p99 %.3fms | %.2fx\n", drawCount, threads, median, milli(everything.percentile(99.0)), singleThread / median);
+
+			// Only the last run has the scene sit still & change one draw at a time
+
+			if (threads == maxThreads)
+			{
+				zkelp::latency_histogram_t idle, single;
+				runFrames(idle, [](std::uint32_t) {});
+				runFrames(single, [](std::uint32_t frame) {
+					auto& drawList = vulkan::vulkanEngine.getDrawList();
+					drawList.update((frame * 7919u) % drawList.size(), types::DrawCommand{});
+				});
+
+				logger.log("recording | %u draws | %2u threads | static scene p50 %.3fms | one draw changed p50 %.3fms\n", drawCount, threads,
+					milli(idle.percentile(50.0)), milli(single.percentile(50.0)));
+			}
+
+			vulkan::vulkanEngine.setDrawList(draws, nullptr);
+		}
+
+		vulkan::vulkanEngine.cleanup(true);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+/*
+*	Desc: Scheduler benchmark
+*	Note: Compares the old single-thread task loop against the worker pool at different worker counts, & what suspending a coroutine each tick costs
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "../core/scheduler/scheduler.hpp"
+#include "../core/scheduler/coroutines.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace scheduler_bench
+	{
+		constexpr auto taskCount{ 512u };
+		constexpr auto tickCount{ 200u };
+		constexpr auto workPerTask{ 2000u };
+
+		// Some busy work that can't be folded away
+
+		struct BusyTask final : zkelp::scheduler_types::BaseTask
+		{
+			std::uint64_t state{ 0u };
+
+			virtual bool mainTick()
+			{
+				for (auto i = 0u; i < workPerTask; i++)
+					state = state * 6364136223846793005ull + 1442695040888963407ull;
+				return true;
+			}
+		};
+
+		// The same work written as a coroutine, suspending until the next tick between rounds
+
+		static zkelp::coroutines::co_task_t busyRoutine()
+		{
+			std::uint64_t state{ 0u };
+
+			for (auto tick = 0u; tick < tickCount; tick++)
+			{
+				for (auto i = 0u; i < workPerTask; i++)
+					state = state * 6364136223846793005ull + 1442695040888963407ull;
+
+				co_await zkelp::coroutines::next_frame{};
+			}
+		}
+
+		static auto tasksPerSecond(std::chrono::steady_clock::duration elapsed)
+		{
+			const auto seconds = std::chrono::duration<double>(elapsed).count();
+			return static_cast<double>(taskCount) * tickCount / seconds;
+		}
+	}
+
+	static void schedulerBenchmark()
+	{
+		using namespace scheduler_bench;
+
+		std::vector<BusyTask> tasks(taskCount);
+
+		// The old loop, one thread walking every task
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (auto tick = 0u; tick < tickCount; tick++)
+			for (auto& task : tasks)
+				task.mainTick();
+
+		const auto serial = tasksPerSecond(std::chrono::steady_clock::now() - start);
+		logger.log("scheduler | single thread loop : %.0f tasks/sec\n", serial);
+
+		// Same ticks over the pool, the submitting thread doesn't help so the worker count is honest
+
+		for (const auto workerCount : { 1u, 2u, 4u, 8u, 16u })
+		{
+			zkelp::worker_pool_t pool(workerCount);
+
+			start = std::chrono::steady_clock::now();
+
+			for (auto tick = 0u; tick < tickCount; tick++)
+			{
+				zkelp::scheduler_types::job_group_t group;
+
+				for (auto& task : tasks)
+					pool.submit([&task] { task.mainTick(); }, &group);
+
+				pool.wait(group, false);
+			}
+
+			const auto pooled = tasksPerSecond(std::chrono::steady_clock::now() - start);
+			logger.log("scheduler | %2u workers : %.0f tasks/sec (%.2fx)\n", workerCount, pooled, pooled / serial);
+		}
+
+		// Coroutine tasks ticked by hand on one thread, the gap to the plain loop is resuming & suspending (frames come from the pool)
+
+		std::vector<zkelp::scheduler_types::coroutineTask*> routines;
+		routines.reserve(taskCount);
+
+		start = std::chrono::steady_clock::now();
+
+		for (auto i = 0u; i < taskCount; i++)
+			routines.push_back(new zkelp::scheduler_types::coroutineTask(busyRoutine(), "busy routine"));
+
+		for (auto tick = 0u; tick <= tickCount; tick++) // One more tick than rounds, the last one runs them off the end
+			for (auto& routine : routines)
+				if (routine != nullptr && !routine->mainTick())
+					std::exchange(routine, nullptr)->onRemoved();
+
+		const auto coroutines = tasksPerSecond(std::chrono::steady_clock::now() - start);
+		logger.log("scheduler | coroutines, single thread : %.0f tasks/sec (%.2fx)\n", coroutines, coroutines / serial);
+	}
+}
\ No newline at end of file
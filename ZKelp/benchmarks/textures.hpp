@@ -0,0 +1,291 @@
+/*
+*	Desc: Texture upload benchmark
+*	Note: Loads 1k small textures headless the old way (dedicated allocations, three single time submits & queue waits each) and batched (sub-allocated,
+*	one transfer submit), decoding is left out since both pay it the same
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "../core/rendering/engines/vulkan/vulkan.hpp"
+#include "../utilities/utilFlags.hpp"
+#include "../utilities/console/logger.hpp"
+
+namespace benchmarks
+{
+	namespace textures_bench
+	{
+		constexpr auto textureCount{ 1'000u };
+		constexpr auto textureSize{ 64u };
+
+		static void destroyTextures(VkDevice device, std::vector<types::Texture>& textures)
+		{
+			for (auto& texture : textures)
+			{
+				vkDestroySampler(device, texture.sampler, nullptr);
+				vkDestroyImageView(device, texture.view, nullptr);
+				vkDestroyImage(device, texture.image, nullptr);
+				vulkan::deviceAllocator.free(texture.memory);
+			}
+
+			textures.clear();
+		}
+
+		// What createTexture did before batching, kept here since the engine's own helpers moved on (sub-allocated memory, fenced submits).
+		// Every buffer & image gets its own allocation & every command its own submit followed by a queue wait
+
+		namespace old
+		{
+			struct Texture
+			{
+				VkImage image{ VK_NULL_HANDLE };
+				VkDeviceMemory memory{ VK_NULL_HANDLE };
+				VkImageView view{ VK_NULL_HANDLE };
+				VkSampler sampler{ VK_NULL_HANDLE };
+			};
+
+			static VkDeviceMemory allocate(VkDevice device, VkPhysicalDevice physicalDevice, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties)
+			{
+				VkPhysicalDeviceMemoryProperties memProperties;
+				vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+				VkMemoryAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocInfo.allocationSize = requirements.size;
+				allocInfo.memoryTypeIndex = UINT32_MAX;
+
+				for (auto i = 0u; i < memProperties.memoryTypeCount; i++)
+				{
+					if ((requirements.memoryTypeBits & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+					{
+						allocInfo.memoryTypeIndex = i;
+						break;
+					}
+				}
+
+				VkDeviceMemory memory;
+				if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+					throw err::err("failed to allocate memory for the old texture path");
+				return memory;
+			}
+
+			static VkCommandBuffer beginCommands(VkDevice device, VkCommandPool commandPool)
+			{
+				VkCommandBufferAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandPool = commandPool;
+				allocInfo.commandBufferCount = 1;
+
+				VkCommandBuffer commandBuffer;
+				vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+				VkCommandBufferBeginInfo beginInfo{};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+				return commandBuffer;
+			}
+
+			static void endCommands(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkCommandBuffer commandBuffer)
+			{
+				vkEndCommandBuffer(commandBuffer);
+
+				VkSubmitInfo submitInfo{};
+				submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &commandBuffer;
+
+				vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+				vkQueueWaitIdle(queue);
+
+				vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+			}
+
+			static void transition(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, bool toShader)
+			{
+				const auto commandBuffer = beginCommands(device, commandPool);
+
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.oldLayout = toShader ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = toShader ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = image;
+				barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				barrier.srcAccessMask = toShader ? static_cast<VkAccessFlags>(VK_ACCESS_TRANSFER_WRITE_BIT) : 0u;
+				barrier.dstAccessMask = toShader ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+
+				vkCmdPipelineBarrier(commandBuffer, toShader ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					toShader ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+				endCommands(device, queue, commandPool, commandBuffer);
+			}
+
+			static void copy(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkBuffer buffer, VkImage image)
+			{
+				const auto commandBuffer = beginCommands(device, commandPool);
+
+				VkBufferImageCopy region{};
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.imageExtent = { textureSize, textureSize, 1 };
+				vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+				endCommands(device, queue, commandPool, commandBuffer);
+			}
+
+			static void destroy(VkDevice device, std::vector<Texture>& textures)
+			{
+				for (const auto& texture : textures)
+				{
+					vkDestroySampler(device, texture.sampler, nullptr);
+					vkDestroyImageView(device, texture.view, nullptr);
+					vkDestroyImage(device, texture.image, nullptr);
+					vkFreeMemory(device, texture.memory, nullptr);
+				}
+
+				textures.clear();
+			}
+		}
+
+		static auto loadOld(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue queue, VkCommandPool commandPool, const std::vector<std::uint8_t>& pixels)
+		{
+			const VkDeviceSize imageSize = pixels.size();
+
+			std::vector<old::Texture> textures(textureCount);
+
+			for (auto& texture : textures)
+			{
+				// Staging buffer, mapped & filled
+
+				VkBufferCreateInfo bufferInfo{};
+				bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferInfo.size = imageSize;
+				bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				VkBuffer stagingBuffer;
+				if (vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS)
+					throw err::err("failed to create a staging buffer for the old texture path");
+
+				VkMemoryRequirements requirements;
+				vkGetBufferMemoryRequirements(device, stagingBuffer, &requirements);
+
+				const auto stagingMemory = old::allocate(device, physicalDevice, requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
+
+				void* data;
+				vkMapMemory(device, stagingMemory, 0, imageSize, 0, &data);
+				memcpy(data, pixels.data(), static_cast<size_t>(imageSize));
+				vkUnmapMemory(device, stagingMemory);
+
+				// The image, its own allocation too
+
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.extent = { textureSize, textureSize, 1 };
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				if (vkCreateImage(device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS)
+					throw err::err("failed to create an image for the old texture path");
+
+				vkGetImageMemoryRequirements(device, texture.image, &requirements);
+				texture.memory = old::allocate(device, physicalDevice, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				vkBindImageMemory(device, texture.image, texture.memory, 0);
+
+				old::transition(device, queue, commandPool, texture.image, false);
+				old::copy(device, queue, commandPool, stagingBuffer, texture.image);
+				old::transition(device, queue, commandPool, texture.image, true);
+
+				vkDestroyBuffer(device, stagingBuffer, nullptr);
+				vkFreeMemory(device, stagingMemory, nullptr);
+
+				texture.view = vulkan::createImageView(device, texture.image, VK_FORMAT_R8G8B8A8_SRGB);
+				texture.sampler = vulkan::createSampler(device, physicalDevice);
+			}
+
+			return textures;
+		}
+
+		// Same as createTextures past the decode, waited on at the end so both are timed until the textures are usable
+
+		static auto loadBatched(VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<std::uint8_t>& pixels)
+		{
+			std::vector<types::Texture> textures;
+			std::vector<vulkan::memory::ImageUpload> uploads;
+
+			textures.reserve(textureCount);
+			uploads.reserve(textureCount);
+
+			for (auto i = 0u; i < textureCount; i++)
+			{
+				auto [texture, upload] = vulkan::stageTexture(device, physicalDevice, pixels.data(), textureSize, textureSize);
+				textures.push_back(texture);
+				uploads.push_back(upload);
+			}
+
+			vulkan::transferQueue.copyImages(uploads);
+			const auto uploaded = vulkan::transferQueue.submit();
+
+			for (auto& texture : textures)
+				texture.uploaded = uploaded;
+
+			vulkan::transferQueue.wait(uploaded);
+			return textures;
+		}
+	}
+
+	static void texturesBenchmark()
+	{
+		using namespace textures_bench;
+
+		vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+
+		const auto device = vulkan::vulkanEngine.getDevice();
+		const auto physicalDevice = vulkan::vulkanEngine.getPhysicalDevice();
+
+		// Checkerboard, the contents don't matter but they shouldn't all be zero either
+
+		std::vector<std::uint8_t> pixels(textureSize * textureSize * 4u);
+		for (auto i = 0u; i < textureSize * textureSize; i++)
+		{
+			const auto value = static_cast<std::uint8_t>((((i % textureSize) / 8u + (i / textureSize) / 8u) % 2u) * 255u);
+			pixels[i * 4u + 0u] = value;
+			pixels[i * 4u + 1u] = value;
+			pixels[i * 4u + 2u] = value;
+			pixels[i * 4u + 3u] = 255u;
+		}
+
+		const auto milli = [](std::chrono::steady_clock::duration time) { return std::chrono::duration<double, std::milli>(time).count(); };
+
+		auto start = std::chrono::steady_clock::now();
+		auto oldTextures = loadOld(device, physicalDevice, vulkan::vulkanEngine.getGraphicsQueue(), vulkan::vulkanEngine.getCommandPool(), pixels);
+		const auto oldTime = std::chrono::steady_clock::now() - start;
+
+		old::destroy(device, oldTextures);
+
+		start = std::chrono::steady_clock::now();
+		auto textures = loadBatched(device, physicalDevice, pixels);
+		const auto batchedTime = std::chrono::steady_clock::now() - start;
+
+		destroyTextures(device, textures);
+
+		logger.log("textures | %u textures %ux%u | old %.3fms (%u allocations, %u queue waits) | batched %.3fms (1 submit) | %.2fx\n", textureCount, textureSize, textureSize,
+			milli(oldTime), textureCount * 2u, textureCount * 3u, milli(batchedTime), milli(oldTime) / std::max(milli(batchedTime), 0.001));
+
+		vulkan::vulkanEngine.cleanup(true);
+	}
+}
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <GLFW/glfw3.h>
 
 #include "side-builders.hpp"
+#include "../pipeline-cache.hpp"
 #include "../types/vtypes.hpp"
 
 #include "../../../../../utilities/utilFlags.hpp"
@@ -19,7 +20,7 @@
 
 namespace vulkan
 {
-	static auto createInstanceAndSurface(GLFWwindow* window)
+	static auto createInstance(std::vector<const char*> extensions)
 	{
 		VkApplicationInfo appInfo = {};
 		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -27,17 +28,7 @@ namespace vulkan
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = utils::mainContextName;
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
-
-		// Get extentions to put on the vulkan instance
-
-		unsigned int glfwExtensionCount;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions;
-		for (auto i = 0u; i < glfwExtensionCount; i++)
-			extensions.push_back(glfwExtensions[i]);
+		appInfo.apiVersion = VK_API_VERSION_1_2; // Dedicated allocations (1.1) & timeline semaphores (1.2) are core from here
 
 	//	extensions.push_back("VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME");
 
@@ -74,17 +65,36 @@ namespace vulkan
 		if (res != VK_SUCCESS)
 			throw err::err("can't make vulkan instance");
 
+		return instance;
+	}
+
+	static auto createInstanceAndSurface(GLFWwindow* window)
+	{
+		// Get extentions to put on the vulkan instance
+
+		unsigned int glfwExtensionCount;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		std::vector<const char*> extensions;
+		for (auto i = 0u; i < glfwExtensionCount; i++)
+			extensions.push_back(glfwExtensions[i]);
+
+		const auto instance = createInstance(extensions);
+
 		// Make window surface
 
 		VkSurfaceKHR windowSurface;
-		 res = glfwCreateWindowSurface(instance, window, NULL, &windowSurface);
+		const auto res = glfwCreateWindowSurface(instance, window, NULL, &windowSurface);
 		if (res != VK_SUCCESS)
 			throw err::err("can't create window surface");
 
 		return std::make_tuple(instance, windowSurface);
 	}
 
-	static auto findPhysicalDevice(VkInstance instance)
+	// Headless runs don't present, so any device goes (software ones like lavapipe or SwiftShader included)
+
+	static auto findPhysicalDevice(VkInstance instance, bool presenting = true)
 	{
 		VkPhysicalDevice physicalDevice;
 
@@ -102,26 +112,29 @@ namespace vulkan
 		// Later check if device vulkan supported version is up-to-date
 		// ...
 
-		// Check for extension support
+		// Check for extension support (only presenting needs any)
 
-		auto extensionCount{ 0u };
-		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		if (presenting)
+		{
+			auto extensionCount{ 0u };
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
 
-		if (!extensionCount)
-			throw err::err("your device supports no extensions");
+			if (!extensionCount)
+				throw err::err("your device supports no extensions");
 
-		// Check for swapchain support
+			// Check for swapchain support
 
-		std::vector<VkExtensionProperties> deviceExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, deviceExtensions.data());
+			std::vector<VkExtensionProperties> deviceExtensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, deviceExtensions.data());
 
-		auto supportsSwapchain{ false };
-		for (const auto& extension : deviceExtensions)
-			if (strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
-				supportsSwapchain = true;
+			auto supportsSwapchain{ false };
+			for (const auto& extension : deviceExtensions)
+				if (strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+					supportsSwapchain = true;
 
-		if(!supportsSwapchain)
-			throw err::err("your device doesn't support swapchain");
+			if(!supportsSwapchain)
+				throw err::err("your device doesn't support swapchain");
+		}
 
 		if constexpr (utils::vulkanDbg)
 		{
@@ -186,33 +199,98 @@ namespace vulkan
 		return std::make_tuple(graphicsQueueIndex.value(), presentQueueIndex.value());
 	}
 
-	static auto createLogicalDevices(VkPhysicalDevice physicalDevice, std::tuple<std::uint32_t, std::uintptr_t> queueIndexes)
+	// No surface to check against, both indexes are the graphics family
+
+	static auto getGraphicsQueueIndexes(VkPhysicalDevice physicalDevice)
 	{
-		// Make queue create information
+		auto familyQueuesCount{ 0u };
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, nullptr);
 
-		VkDeviceQueueCreateInfo queueCreateInfo[2] = {};
-		float queuePriority = 1.0f;
+		if (!familyQueuesCount)
+			throw err::err("your device has 0 family queues");
 
-		queueCreateInfo[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo[0].queueFamilyIndex = std::get<0>(queueIndexes);
-		queueCreateInfo[0].queueCount = 1;
-		queueCreateInfo[0].pQueuePriorities = &queuePriority;
+		std::vector<VkQueueFamilyProperties> queueFamilies(familyQueuesCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, queueFamilies.data());
+
+		for (auto i = 0u; i < familyQueuesCount; i++)
+			if (queueFamilies[i].queueCount > 0 && queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				return std::make_tuple(i, i);
+
+		throw err::err("no graphics queue was found");
+	}
+
+	// A family that can only copy runs on the copy engines, next to the graphics work instead of in between it. Falls back to graphics
+
+	static auto findTransferQueueIndex(VkPhysicalDevice physicalDevice, std::uint32_t graphicsQueueIndex)
+	{
+		auto familyQueuesCount{ 0u };
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(familyQueuesCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, queueFamilies.data());
 
-		queueCreateInfo[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo[0].queueFamilyIndex = static_cast<std::uint32_t>(std::get<1>(queueIndexes));
-		queueCreateInfo[0].queueCount = 1;
-		queueCreateInfo[0].pQueuePriorities = &queuePriority;
+		std::optional<std::uint32_t> transferQueueIndex{ std::nullopt };
+
+		for (auto i = 0u; i < familyQueuesCount; i++)
+		{
+			const auto flags = queueFamilies[i].queueFlags;
+			if (!queueFamilies[i].queueCount || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+				continue;
+
+			// Transfer only beats async compute
+
+			if (!(flags & VK_QUEUE_COMPUTE_BIT))
+				return i;
+
+			if (!transferQueueIndex.has_value())
+				transferQueueIndex = i;
+		}
+
+		return transferQueueIndex.value_or(graphicsQueueIndex);
+	}
+
+	static auto createLogicalDevices(VkPhysicalDevice physicalDevice, std::tuple<std::uint32_t, std::uintptr_t> queueIndexes, bool presenting = true, std::optional<std::uint32_t> transferQueueIndex = {})
+	{
+		// Make queue create information, one per distinct family
+
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfo;
+		float queuePriority = 1.0f;
+
+		for (const auto family : { std::get<0>(queueIndexes), static_cast<std::uint32_t>(std::get<1>(queueIndexes)), transferQueueIndex.value_or(std::get<0>(queueIndexes)) })
+		{
+			if (std::any_of(queueCreateInfo.begin(), queueCreateInfo.end(), [family](const VkDeviceQueueCreateInfo& info) { return info.queueFamilyIndex == family; }))
+				continue;
+
+			VkDeviceQueueCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			info.queueFamilyIndex = family;
+			info.queueCount = 1;
+			info.pQueuePriorities = &queuePriority;
+			queueCreateInfo.push_back(info);
+		}
 
 		// Create device information
 
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.pQueueCreateInfos = queueCreateInfo;
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfo.data();
+		deviceCreateInfo.queueCreateInfoCount = static_cast<std::uint32_t>(queueCreateInfo.size());
 
-		if (std::get<0>(queueIndexes) == std::get<01>(queueIndexes))
-			deviceCreateInfo.queueCreateInfoCount = 1;
-		else
-			deviceCreateInfo.queueCreateInfoCount = 2;
+		// Uploads signal a timeline semaphore when they're done
+
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+		VkPhysicalDeviceFeatures2 supportedFeatures = {};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+		if (!timelineFeatures.timelineSemaphore)
+			throw err::err("your device doesn't support timeline semaphores");
+
+		timelineFeatures.pNext = nullptr;
+		deviceCreateInfo.pNext = &timelineFeatures;
 
 		// Some device features we can toggle
 		// Note: This version is ugly, I'll like to go for a compile-time configurator to be applied during run-time
@@ -223,8 +301,13 @@ namespace vulkan
 		enabledFeatures.shaderCullDistance = VK_TRUE;
 		enabledFeatures.samplerAnisotropy  = VK_TRUE;
 
+		// Block compressed textures, KTX2s in formats left off here fall back to their PNG
+
+		enabledFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+		enabledFeatures.textureCompressionASTC_LDR = supportedFeatures.features.textureCompressionASTC_LDR;
+
 		const char* deviceExtensions = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-		deviceCreateInfo.enabledExtensionCount = 1;
+		deviceCreateInfo.enabledExtensionCount = presenting ? 1 : 0;
 		deviceCreateInfo.ppEnabledExtensionNames = &deviceExtensions;
 		deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
 
@@ -246,6 +329,14 @@ namespace vulkan
 		return std::make_tuple(device, deviceMemoryProperties);
 	}
 
+	static auto getQueue(VkDevice device, std::uint32_t queueIndex)
+	{
+		VkQueue queue;
+		vkGetDeviceQueue(device, queueIndex, 0, &queue);
+
+		return queue;
+	}
+
 	static auto getQueues(VkDevice device, std::tuple<std::uint32_t, std::uintptr_t> queueIndexes)
 	{
 		VkQueue graphicsQueue;
@@ -268,7 +359,10 @@ namespace vulkan
 		createInfo.pUserData = nullptr;
 
 		auto CreateDebugReportCallback = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT"));
-		VkDebugUtilsMessengerEXT callback;
+		VkDebugUtilsMessengerEXT callback{ VK_NULL_HANDLE };
+
+		if (CreateDebugReportCallback == nullptr)
+			throw err::err("cannot create debug pass, VK_EXT_debug_utils isn't enabled");
 
 		if (CreateDebugReportCallback(instance, &createInfo, nullptr, &callback) != VK_SUCCESS)
 			throw err::err("cannot create debug pass");
@@ -299,10 +393,24 @@ namespace vulkan
 		return std::make_tuple(imageAvailableSemaphore, renderingFinishedSemaphore);
 	}
 
-	static auto createCommandPool(VkDevice device, std::uint32_t graphicsQueueIndex)
+	static auto createFence(VkDevice device, bool signaled = false)
+	{
+		VkFenceCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		createInfo.flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
+
+		VkFence fence;
+		if (vkCreateFence(device, &createInfo, nullptr, &fence) != VK_SUCCESS)
+			throw err::err("cannot create fence");
+
+		return fence;
+	}
+
+	static auto createCommandPool(VkDevice device, std::uint32_t graphicsQueueIndex, VkCommandPoolCreateFlags flags = 0)
 	{
 		VkCommandPoolCreateInfo poolCreateInfo = {};
 		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCreateInfo.flags = flags;
 		poolCreateInfo.queueFamilyIndex = graphicsQueueIndex;
 
 		VkCommandPool commandPool;
@@ -312,11 +420,10 @@ namespace vulkan
 		return commandPool;
 	}
 
-	static auto createVertexBuffer(std::tuple<VkDevice, VkPhysicalDeviceMemoryProperties> deviceSet, VkQueue graphicsQueue, VkCommandPool commandPool)
+	static auto createVertexBuffer(std::tuple<VkDevice, VkPhysicalDeviceMemoryProperties> deviceSet)
 	{
 		// Quick definition
 		const auto device = std::get<0>(deviceSet);
-		const auto deviceMemoryProps = std::get<1>(deviceSet);
 
 		// Creating simple vertice information
 
@@ -331,141 +438,62 @@ namespace vulkan
 		auto verticesSize = static_cast<std::uint32_t>(vertices.size() * sizeof(vertices[0]));
 		auto indicesSize = static_cast<std::uint32_t>(indices.size() * sizeof(indices[0]));
 
-		// We allocate memory & create structure for simple "Stage buffers"
-
-		VkMemoryAllocateInfo memoryAllocation{ };
-		memoryAllocation.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-		VkMemoryRequirements memoryRequirements{ };
+		// Both go through the staging ring, it's recycled once the copy's fence signals
 
 		struct {
-			struct StageBuffer
-			{
-				VkDeviceMemory memory;
-				VkBuffer buffer;
-			};
-
-			StageBuffer vertices;
-			StageBuffer indices;
+			memory::StagingSlice vertices;
+			memory::StagingSlice indices;
 		} stageBuffers;
 
-
-		// We create our command buffer
-
-		VkCommandBufferAllocateInfo cmdBufInfo = {};
-		cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		cmdBufInfo.commandPool = commandPool;
-		cmdBufInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		cmdBufInfo.commandBufferCount = 1;
-
-		VkCommandBuffer copyCommandBuffer;
-		vkAllocateCommandBuffers(device, &cmdBufInfo, &copyCommandBuffer);
-
 		// Buffer handling
 
 		const auto vertexBuffer(new types::VertexBuffer);
 
-		void* tempData;
-
 		// Handle vertices stage buffer
 
 		std::function<void()> createVertices = [&] {
-			// Create buffer on the CPU
-
-			VkBufferCreateInfo vertexBufferInfo = {};
-			vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			vertexBufferInfo.size = verticesSize;
-			vertexBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-			vkCreateBuffer(device, &vertexBufferInfo, nullptr, &stageBuffers.vertices.buffer);
-
-			// Set up buffer to host
-
-			vkGetBufferMemoryRequirements(device, stageBuffers.vertices.buffer, &memoryRequirements);
-			memoryAllocation.allocationSize = memoryRequirements.size;
-			getMemoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memoryAllocation.memoryTypeIndex);
-			vkAllocateMemory(device, &memoryAllocation, nullptr, &stageBuffers.vertices.memory);
+			// Stage on the CPU (the ring is mapped for good, so it's just a copy)
 
-			vkMapMemory(device, stageBuffers.vertices.memory, 0, verticesSize, 0, &tempData);
-			memcpy(tempData, vertices.data(), verticesSize);
-			vkUnmapMemory(device, stageBuffers.vertices.memory);
-			vkBindBufferMemory(device, stageBuffers.vertices.buffer, stageBuffers.vertices.memory, 0);
+			stageBuffers.vertices = stagingRing.allocate(verticesSize);
+			memcpy(stageBuffers.vertices.mapped, vertices.data(), verticesSize);
 
 			// Now setup this buffer within the GPU
 
+			VkBufferCreateInfo vertexBufferInfo = {};
+			vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			vertexBufferInfo.size = verticesSize;
 			vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 			vkCreateBuffer(device, &vertexBufferInfo, nullptr, &vertexBuffer->buffer);
-			vkGetBufferMemoryRequirements(device, vertexBuffer->buffer, &memoryRequirements);
-			memoryAllocation.allocationSize = memoryRequirements.size;
-			getMemoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocation.memoryTypeIndex);
-
-			vkAllocateMemory(device, &memoryAllocation, nullptr, &vertexBuffer->memory);
-			vkBindBufferMemory(device, vertexBuffer->buffer, vertexBuffer->memory, 0);
+			vertexBuffer->memory = deviceAllocator.allocateBuffer(vertexBuffer->buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		};
 
 		// Handle indicies stage buffer
 
 		std::function<void()> createIndicies = [&] {
 
+			stageBuffers.indices = stagingRing.allocate(indicesSize);
+			memcpy(stageBuffers.indices.mapped, indices.data(), indicesSize);
+
+			// And allocate another gpu only buffer for indices
 			VkBufferCreateInfo indexBufferInfo = {};
 			indexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 			indexBufferInfo.size = indicesSize;
-			indexBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-			vkCreateBuffer(device, &indexBufferInfo, nullptr, &stageBuffers.indices.buffer);
-			vkGetBufferMemoryRequirements(device, stageBuffers.indices.buffer, &memoryRequirements);
-			memoryAllocation.allocationSize = memoryRequirements.size;
-			getMemoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memoryAllocation.memoryTypeIndex);
-			vkAllocateMemory(device, &memoryAllocation, nullptr, &stageBuffers.indices.memory);
-			vkMapMemory(device, stageBuffers.indices.memory, 0, indicesSize, 0, &tempData);
-			memcpy(tempData, indices.data(), indicesSize);
-			vkUnmapMemory(device, stageBuffers.indices.memory);
-			vkBindBufferMemory(device, stageBuffers.indices.buffer, stageBuffers.indices.memory, 0);
-
-			// And allocate another gpu only buffer for indices
 			indexBufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 			vkCreateBuffer(device, &indexBufferInfo, nullptr, &vertexBuffer->index);
-			vkGetBufferMemoryRequirements(device, vertexBuffer->index, &memoryRequirements);
-			memoryAllocation.allocationSize = memoryRequirements.size;
-			getMemoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocation.memoryTypeIndex);
-			vkAllocateMemory(device, &memoryAllocation, nullptr, &vertexBuffer->indexMemory);
-			vkBindBufferMemory(device, vertexBuffer->index, vertexBuffer->indexMemory, 0);
-
-			VkCommandBufferBeginInfo bufferBeginInfo = {};
-			bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-			vkBeginCommandBuffer(copyCommandBuffer, &bufferBeginInfo);
+			vertexBuffer->indexMemory = deviceAllocator.allocateBuffer(vertexBuffer->index, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = verticesSize;
-			vkCmdCopyBuffer(copyCommandBuffer, stageBuffers.vertices.buffer, vertexBuffer->buffer, 1, &copyRegion);
-			copyRegion.size = indicesSize;
-			vkCmdCopyBuffer(copyCommandBuffer, stageBuffers.indices.buffer, vertexBuffer->index, 1, &copyRegion);
+			// Both copies go out on the transfer queue, the first frame is submitted after them so it needs no wait
 
-			vkEndCommandBuffer(copyCommandBuffer);
+			transferQueue.copyBuffer(stageBuffers.vertices, vertexBuffer->buffer, verticesSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+			transferQueue.copyBuffer(stageBuffers.indices, vertexBuffer->index, indicesSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 		};
 
 		createVertices();
 		createIndicies();
 
-
 		// Submit to queue
 
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &copyCommandBuffer;
-
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
-
-		vkFreeCommandBuffers(device, commandPool, 1, &copyCommandBuffer);
-
-		vkDestroyBuffer(device, stageBuffers.vertices.buffer, nullptr);
-		vkFreeMemory(device, stageBuffers.vertices.memory, nullptr);
-		vkDestroyBuffer(device, stageBuffers.indices.buffer, nullptr);
-		vkFreeMemory(device, stageBuffers.indices.memory, nullptr);
+		transferQueue.submit();
 
 		auto vertexDescriptor(new types::VertexInputBindingDescriptors);
 
@@ -493,7 +521,6 @@ namespace vulkan
 		// Quick definition
 
 		const auto device = std::get<0>(deviceSet);
-		const auto deviceMemoryProps = std::get<1>(deviceSet);
 
 		// Create a uniform buffer
 
@@ -506,21 +533,19 @@ namespace vulkan
 
 		vkCreateBuffer(device, &bufferInfo, nullptr, &uniformBuffer->buffer);
 
-		VkMemoryRequirements memoryRequirements;
-		vkGetBufferMemoryRequirements(device, uniformBuffer->buffer, &memoryRequirements);
+		uniformBuffer->memory = deviceAllocator.allocateBuffer(uniformBuffer->buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memoryRequirements.size;
-		getMemoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &allocInfo.memoryTypeIndex);
+		// Stays mapped (its block is), every frame has its own so writing one never races the GPU reading another
 
-		vkAllocateMemory(device, &allocInfo, nullptr, &uniformBuffer->memory);
-		vkBindBufferMemory(device, uniformBuffer->buffer, uniformBuffer->memory, 0);
+		uniformBuffer->size = bufferInfo.size;
+		uniformBuffer->mapped = uniformBuffer->memory.mapped;
 
 		return uniformBuffer;
 	}
 
-	static auto createSwapChain(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR windowSurface, VkSwapchainKHR oldSwapchain = nullptr)
+	// A recreated swapchain hands over from oldSwapchain, which is only retired here. The caller destroys it once nothing drawn into its images is in flight
+
+	static auto createSwapChain(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR windowSurface, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE)
 	{
 		// e
 
@@ -576,7 +601,7 @@ namespace vulkan
 		if (surfaceCapabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
 			surfaceTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 		else
-			surfaceCapabilities.currentTransform;
+			surfaceTransform = surfaceCapabilities.currentTransform;
 
 		VkPresentModeKHR presentMode = choosePresentMode(presentModes);
 
@@ -603,10 +628,6 @@ namespace vulkan
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchainInformation->swapchain) != VK_SUCCESS)
 			throw err::err("failed to create swapchain!");
 
-		if (oldSwapchain != nullptr)
-			vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
-
-		oldSwapchain = swapchainInformation->swapchain;
 		swapchainInformation->format = surfaceFormat.format;
 
 		auto actualImageCount = 0u;
@@ -621,7 +642,9 @@ namespace vulkan
 		return swapchainInformation;
 	}
 
-	static auto makeRenderPass(VkDevice device, VkFormat swapChainFormat)
+	// Target layout is what the images sit in outside the pass, presenting or for offscreen ones being read back
+
+	static auto makeRenderPass(VkDevice device, VkFormat swapChainFormat, VkImageLayout targetLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
 	{
 		VkAttachmentDescription attachmentDescription = {};
 		attachmentDescription.format = swapChainFormat;
@@ -630,8 +653,8 @@ namespace vulkan
 		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachmentDescription.initialLayout = targetLayout;
+		attachmentDescription.finalLayout = targetLayout;
 
 		VkAttachmentReference colorAttachmentReference = {};
 		colorAttachmentReference.attachment = 0;
@@ -655,6 +678,53 @@ namespace vulkan
 		return renderPass;
 	}
 
+	// Stands in for the swapchain when there's no window, the images are ours so their memory is kept alongside
+
+	static auto createOffscreenTargets(VkDevice device, VkFormat format, VkExtent2D extent, std::uint32_t count)
+	{
+		auto targets(new types::SwapchainInformation);
+
+		targets->swapchain = VK_NULL_HANDLE;
+		targets->format = format;
+		targets->extent = extent;
+		targets->images.resize(count);
+		targets->imageMemory.resize(count);
+
+		for (auto i = 0u; i < count; i++)
+			createImage(device, extent.width, extent.height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, targets->images[i], targets->imageMemory[i]);
+
+		return targets;
+	}
+
+	// Two timestamps per frame in flight (start & end), the pool is null when the queue can't time anything
+
+	static auto createTimestampQueries(VkDevice device, VkPhysicalDevice physicalDevice, std::uint32_t queueIndex, std::uint32_t commandBufferCount)
+	{
+		auto familyQueuesCount{ 0u };
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(familyQueuesCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyQueuesCount, queueFamilies.data());
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		if (queueIndex >= familyQueuesCount || !queueFamilies[queueIndex].timestampValidBits)
+			return std::make_tuple(static_cast<VkQueryPool>(VK_NULL_HANDLE), 0.0f);
+
+		VkQueryPoolCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		createInfo.queryCount = commandBufferCount * 2;
+
+		VkQueryPool queryPool;
+		if (vkCreateQueryPool(device, &createInfo, nullptr, &queryPool) != VK_SUCCESS)
+			throw err::err("cannot create timestamp query pool");
+
+		return std::make_tuple(queryPool, properties.limits.timestampPeriod); // Nanoseconds per tick
+	}
+
 	static auto createImageViews(VkDevice device, VkFormat swapChainFormat, std::vector<VkImage>& swapChainImages)
 	{
 		// Resize to account for these images
@@ -735,7 +805,9 @@ namespace vulkan
 		return renderPass;
 	}
 
-	static auto createRenderingPipeline(VkDevice device, types::VertexInputBindingDescriptors* Vertexdescriptors, VkRenderPass renderPass, VkExtent2D swapchainExtent)
+	// Viewport & scissor are dynamic (set while recording), so the pipeline outlives any resize
+
+	static auto createRenderingPipeline(VkDevice device, types::VertexInputBindingDescriptors* Vertexdescriptors, VkRenderPass renderPass)
 	{
 		// Pipeline information
 
@@ -771,28 +843,17 @@ namespace vulkan
 		inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapchainExtent.width);
-		viewport.height = static_cast<float>(swapchainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset.x = 0;
-		scissor.offset.y = 0;
-		scissor.extent.width = swapchainExtent.width;
-		scissor.extent.height = swapchainExtent.height;
-
-
 		VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
 		viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportCreateInfo.viewportCount = 1;
-		viewportCreateInfo.pViewports = &viewport;
 		viewportCreateInfo.scissorCount = 1;
-		viewportCreateInfo.pScissors = &scissor;
+
+		const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+		dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicStateCreateInfo.dynamicStateCount = 2;
+		dynamicStateCreateInfo.pDynamicStates = dynamicStates;
 
 		VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo = {};
 		rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -871,13 +932,14 @@ namespace vulkan
 		pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
 		pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
 		pipelineCreateInfo.pColorBlendState = &colorBlendCreateInfo;
+		pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 		pipelineCreateInfo.layout = pipelineInfo->layout;
 		pipelineCreateInfo.renderPass = renderPass;
 		pipelineCreateInfo.subpass = 0;
 		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineCreateInfo.basePipelineIndex = -1;
 
-		const auto res = vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipelineInfo->pipeline);
+		const auto res = vkCreateGraphicsPipelines(device, pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &pipelineInfo->pipeline);
 		if (res != VK_SUCCESS)
 			throw err::err("failed to create graphics pipeline");
 
@@ -887,29 +949,116 @@ namespace vulkan
 		return pipelineInfo;
 	}
 
-	static auto createCommandBuffers(VkDevice device, VkCommandPool commandPool, VkRenderPass renderPass, types::SwapchainInformation* swapchainInfo,
-		std::tuple<std::uint32_t, std::uint32_t> queueIndexes, std::tuple<types::VertexBuffer* , types::VertexInputBindingDescriptors*> vertexBuffInfo, 
-		std::vector<VkFramebuffer> swapChainFrameBuffers, types::graphicsPipelineInformation* pipeLineInfo, VkDescriptorSet descriptorSet)
+	// Everything one frame in flight needs to itself, the fence starts signaled so the first wait on it goes straight through
+
+	static auto createFrames(std::tuple<VkDevice, VkPhysicalDeviceMemoryProperties> deviceSet, std::uint32_t graphicsQueueIndex, VkDescriptorPool descriptorPool,
+		VkDescriptorSetLayout descriptorLayout, std::uint32_t count)
 	{
-		std::vector<VkCommandBuffer> graphicsCommandBuffers;
-		graphicsCommandBuffers.resize(swapchainInfo->images.size());
+		const auto device = std::get<0>(deviceSet);
 
-		// Allocate a command buffer
+		std::vector<types::FrameResources> frames(count);
 
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = commandPool;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = static_cast<std::uint32_t>(swapchainInfo->images.size());
+		for (auto& frame : frames)
+		{
+			std::tie(frame.imageAvailable, frame.renderingFinished) = createSemaphores(device);
+			frame.inFlight = createFence(device, true);
 
-		if (vkAllocateCommandBuffers(device, &allocInfo, graphicsCommandBuffers.data()) != VK_SUCCESS)
-			throw err::err("can't allocate a command buffer, do you have enough memory?");
+			// Reset as a whole every time the frame comes around, so the pool is transient
 
-		// Handle Some descriptors for the screening
+			frame.commandPool = createCommandPool(device, graphicsQueueIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = frame.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+				throw err::err("can't allocate a command buffer, do you have enough memory?");
+
+			frame.uniformBuffer = createUniformBuffer(deviceSet);
+			frame.descriptorSet = createDescriptorSet(device, descriptorPool, descriptorLayout, frame.uniformBuffer);
+		}
+
+		return frames;
+	}
+
+	// A recorder's index-th secondary buffer, allocated the first time it's needed
+
+	static VkCommandBuffer secondaryBuffer(VkDevice device, types::SecondaryRecorder& recorder, std::size_t index)
+	{
+		while (recorder.buffers.size() <= index)
+		{
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = recorder.pool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+				throw err::err("can't allocate a secondary command buffer");
+			recorder.buffers.push_back(commandBuffer);
+		}
+
+		return recorder.buffers[index];
+	}
+
+	// Records a run of draws into a secondary buffer executed inside the render pass. Only the pass is inherited, so it binds (& sets) everything itself.
+	// It's executed again every frame until its draws change, so it isn't one time submit & leaves the framebuffer open (any swapchain image works)
+
+	static void recordDraws(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkExtent2D extent, types::VertexBuffer* vertexBuffer,
+		types::graphicsPipelineInformation* pipeLineInfo, VkDescriptorSet descriptorSet, const types::DrawCommand* draws, std::size_t drawCount)
+	{
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
 
 		VkCommandBufferBeginInfo beginInfo = {};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeLineInfo->pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeLineInfo->layout, 0, 1, &descriptorSet, 0, nullptr);
+
+		VkViewport viewport = {};
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.extent = extent;
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer->buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, vertexBuffer->index, 0, VK_INDEX_TYPE_UINT32);
+
+		for (auto i = 0u; i < drawCount; i++)
+			vkCmdDrawIndexed(commandBuffer, draws[i].indexCount, draws[i].instanceCount, draws[i].firstIndex, draws[i].vertexOffset, 0);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw err::err("couldn't record a secondary command buffer");
+	}
+
+	// Records one frame into the target image, the drawing itself is in the secondary buffers. Timestamps go in queries (queryIndex, queryIndex + 1)
+	// when there's a pool
+
+	static void recordCommandBuffer(VkCommandBuffer commandBuffer, VkRenderPass renderPass, types::SwapchainInformation* swapchainInfo, std::uint32_t imageIndex,
+		std::tuple<std::uint32_t, std::uint32_t> queueIndexes, VkFramebuffer frameBuffer, const std::vector<VkCommandBuffer>& secondaries,
+		VkImageLayout targetLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VkQueryPool timestampPool = VK_NULL_HANDLE, std::uint32_t queryIndex = 0)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkImageSubresourceRange subResourceRange = {};
 		subResourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -922,83 +1071,76 @@ namespace vulkan
 			{ 0.1f, 0.1f, 0.1f, 1.0f } // R, G, B, A
 		};
 
-		// Make a buffer for every swapchain image
-		for (auto i = 0u; i < swapchainInfo->images.size(); i++)
-		{
-			vkBeginCommandBuffer(graphicsCommandBuffers[i], &beginInfo);
-
-			// If present queue family and graphics queue family are different, then a barrier is necessary
-			// The barrier is also needed initially to transition the image to the present layout
-
-			VkImageMemoryBarrier presentToDrawBarrier = {};
-			presentToDrawBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			presentToDrawBarrier.srcAccessMask = 0;
-			presentToDrawBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			presentToDrawBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			presentToDrawBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-			if (std::get<0>(queueIndexes) != std::get<1>(queueIndexes)) {
-				presentToDrawBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				presentToDrawBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			}
-			else {
-				presentToDrawBarrier.dstQueueFamilyIndex = std::get<0>(queueIndexes);
-				presentToDrawBarrier.srcQueueFamilyIndex = std::get<1>(queueIndexes);
-			}
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-			presentToDrawBarrier.image = swapchainInfo->images[i];
-			presentToDrawBarrier.subresourceRange = subResourceRange;
+		if (timestampPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, timestampPool, queryIndex, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, queryIndex);
+		}
 
-			vkCmdPipelineBarrier(graphicsCommandBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &presentToDrawBarrier);
+		// If present queue family and graphics queue family are different, then a barrier is necessary
+		// The barrier is also needed initially to transition the image to the present layout
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = swapChainFrameBuffers[i];
-			renderPassBeginInfo.renderArea.offset.x;
-			renderPassBeginInfo.renderArea.offset.y = 0;
-			renderPassBeginInfo.renderArea.extent = swapchainInfo->extent;
-			renderPassBeginInfo.clearValueCount = 1;
-			renderPassBeginInfo.pClearValues = &clearColor;
+		VkImageMemoryBarrier presentToDrawBarrier = {};
+		presentToDrawBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		presentToDrawBarrier.srcAccessMask = 0;
+		presentToDrawBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		presentToDrawBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		presentToDrawBarrier.newLayout = targetLayout;
 
-			vkCmdBeginRenderPass(graphicsCommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (std::get<0>(queueIndexes) != std::get<1>(queueIndexes)) {
+			presentToDrawBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			presentToDrawBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		else {
+			presentToDrawBarrier.dstQueueFamilyIndex = std::get<0>(queueIndexes);
+			presentToDrawBarrier.srcQueueFamilyIndex = std::get<1>(queueIndexes);
+		}
 
-			vkCmdBindDescriptorSets(graphicsCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeLineInfo->layout, 0, 1, &descriptorSet, 0, nullptr);
+		presentToDrawBarrier.image = swapchainInfo->images[imageIndex];
+		presentToDrawBarrier.subresourceRange = subResourceRange;
 
-			vkCmdBindPipeline(graphicsCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeLineInfo->pipeline);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &presentToDrawBarrier);
 
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(graphicsCommandBuffers[i], 0, 1, &std::get<0>(vertexBuffInfo)->buffer, &offset);
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffer;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent = swapchainInfo->extent;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearColor;
 
-			vkCmdBindIndexBuffer(graphicsCommandBuffers[i], std::get<0>(vertexBuffInfo)->index, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-			vkCmdDrawIndexed(graphicsCommandBuffers[i], 3, 1, 0, 0, 0);
+		if (!secondaries.empty())
+			vkCmdExecuteCommands(commandBuffer, static_cast<std::uint32_t>(secondaries.size()), secondaries.data());
 
-			vkCmdEndRenderPass(graphicsCommandBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			// If present and graphics queue families differ, then another barrier is required
- 
-			if (std::get<0>(queueIndexes) != std::get<1>(queueIndexes)) {
-				VkImageMemoryBarrier drawToPresentBarrier = {};
-				drawToPresentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				drawToPresentBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-				drawToPresentBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-				drawToPresentBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-				drawToPresentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-				drawToPresentBarrier.dstQueueFamilyIndex = std::get<0>(queueIndexes);;
-				drawToPresentBarrier.srcQueueFamilyIndex = std::get<1>(queueIndexes);
-				drawToPresentBarrier.image = swapchainInfo->images[i];
-				drawToPresentBarrier.subresourceRange = subResourceRange;
+		// If present and graphics queue families differ, then another barrier is required
 
-				vkCmdPipelineBarrier(graphicsCommandBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &drawToPresentBarrier);
-			}
+		if (std::get<0>(queueIndexes) != std::get<1>(queueIndexes)) {
+			VkImageMemoryBarrier drawToPresentBarrier = {};
+			drawToPresentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			drawToPresentBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			drawToPresentBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			drawToPresentBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			drawToPresentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			drawToPresentBarrier.dstQueueFamilyIndex = std::get<0>(queueIndexes);;
+			drawToPresentBarrier.srcQueueFamilyIndex = std::get<1>(queueIndexes);
+			drawToPresentBarrier.image = swapchainInfo->images[imageIndex];
+			drawToPresentBarrier.subresourceRange = subResourceRange;
 
-			if (vkEndCommandBuffer(graphicsCommandBuffers[i]) != VK_SUCCESS)
-				throw err::err("couldn't record command buffer, at {}", i);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &drawToPresentBarrier);
 		}
 
-		vkDestroyPipelineLayout(device, pipeLineInfo->layout, nullptr);
+		if (timestampPool != VK_NULL_HANDLE)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, queryIndex + 1);
 
-		return graphicsCommandBuffers;
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw err::err("couldn't record command buffer, at {}", imageIndex);
 	}
 }
\ No newline at end of file
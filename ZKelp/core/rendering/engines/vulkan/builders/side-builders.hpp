@@ -5,6 +5,8 @@
 #pragma once
 #include <cstdint>
 #include <algorithm>
+#include <tuple>
+#include <string>
 #include <vector>
 #include <optional>
 
@@ -12,36 +14,20 @@
 #include <GLFW/glfw3.h>
 
 
-#define STB_IMAGE_IMPLEMENTATION  
-#include "../../../../../3rd party/stb/image.hpp"
-
 #include "../../../../../utilities/utilFlags.hpp"
 #include "../../../../../utilities/files/fs.hpp"
 #include "../types/vtypes.hpp"
+#include "../memory/allocator.hpp"
+#include "../memory/staging.hpp"
+#include "../memory/transfer.hpp"
+#include "../memory/decode.hpp"
+#include "../memory/ktx2.hpp"
 
 #undef min
 #undef max
 
 namespace vulkan
 {
-	static bool getMemoryType(VkPhysicalDeviceMemoryProperties deviceMemoryProps, uint32_t typeBits, VkFlags props, uint32_t* typeIndex)
-	{
-		auto ret{ false };
-		 
-		for (auto i = 0u; i < 32; i++)
-		{
-			if ((typeBits & 1) == 1)
-				if ((deviceMemoryProps.memoryTypes[i].propertyFlags & props) == props) {
-					*typeIndex = i;
-					ret = true;
-					break;
-				}
-			typeBits >>= 1;
-		}
-
-		return ret;
-	}
-
 	static auto beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool) {
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -61,7 +47,9 @@ namespace vulkan
 		return commandBuffer;
 	}
 
-	static void endSingleTimeCommands(VkDevice device, VkQueue graphicsQueue, VkCommandPool commandPool, VkCommandBuffer commandBuffer) {
+	// Waits on its own submit only (through the fence, one of its own when none's given), not on everything else in the queue
+
+	static void endSingleTimeCommands(VkDevice device, VkQueue graphicsQueue, VkCommandPool commandPool, VkCommandBuffer commandBuffer, VkFence fence = VK_NULL_HANDLE) {
 		vkEndCommandBuffer(commandBuffer);
 
 		VkSubmitInfo submitInfo{};
@@ -69,21 +57,21 @@ namespace vulkan
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
-
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-	}
+		auto waitFence = fence;
+		if (waitFence == VK_NULL_HANDLE)
+		{
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			vkCreateFence(device, &fenceInfo, nullptr, &waitFence);
+		}
 
-	static auto findMemoryType(VkPhysicalDevice physicalDevice, std::int32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		vkQueueSubmit(graphicsQueue, 1, &submitInfo, waitFence);
+		vkWaitForFences(device, 1, &waitFence, VK_TRUE, UINT64_MAX);
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-				return i;
+		if (fence == VK_NULL_HANDLE)
+			vkDestroyFence(device, waitFence, nullptr);
 
-		throw err::err("failed to find memory type");
+		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 
 	static auto choosePresentMode(const std::vector<VkPresentModeKHR> presentModes)
@@ -135,19 +123,19 @@ namespace vulkan
 		return ret.has_value() ? ret.value() : availableFormats[0];
 	}
 
-	static auto createDescriptorPool(VkDevice device)
+	static auto createDescriptorPool(VkDevice device, std::uint32_t setCount = 1)
 	{
 		VkDescriptorPool descriptorPool;
 
 		VkDescriptorPoolSize typeCount;
 		typeCount.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		typeCount.descriptorCount = 1;
+		typeCount.descriptorCount = setCount;
 
 		VkDescriptorPoolCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		createInfo.poolSizeCount = 1;
 		createInfo.pPoolSizes = &typeCount;
-		createInfo.maxSets = 1;
+		createInfo.maxSets = setCount;
 
 		if (vkCreateDescriptorPool(device, &createInfo, nullptr, &descriptorPool) != VK_SUCCESS)
 			throw err::err("failed to create a description pool");
@@ -155,10 +143,9 @@ namespace vulkan
 		return descriptorPool;
 	}
 
-	static auto createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+	static auto createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
 
 		VkBuffer buffer;
-		VkDeviceMemory bufferMemory;
 
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -170,18 +157,7 @@ namespace vulkan
 			throw std::runtime_error("failed to create buffer!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-			throw std::runtime_error("failed to allocate buffer memory!");
-
-		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+		const auto bufferMemory = deviceAllocator.allocateBuffer(buffer, properties);
 
 		return std::tuple(buffer, bufferMemory);
 	}
@@ -233,8 +209,8 @@ namespace vulkan
 
 	static auto createShaderModules(VkDevice device)
 	{
-		fs::Document vertexShader("D:\\Projects\\ZKelp\\x64\\Debug\\resources\\shaders\\vert.spv");
-		fs::Document fragmentShader("D:\\Projects\\ZKelp\\x64\\Debug\\resources\\shaders\\frag.spv");
+		fs::Document vertexShader(utils::resourcesPath / "shaders" / "vert.spv");
+		fs::Document fragmentShader(utils::resourcesPath / "shaders" / "frag.spv");
 
 		// Check if the files were found
 		
@@ -274,8 +250,8 @@ namespace vulkan
 		return std::make_tuple(vertexModule, fragmentModule);
 	}
 
-	static auto createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+	static auto createImage(VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, types::Allocation& imageMemory, std::uint32_t mipLevels = 1)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -283,7 +259,7 @@ namespace vulkan
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
@@ -295,21 +271,10 @@ namespace vulkan
 		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
 			throw err::err("failed to create image");
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-			throw err::err("could not allocate image memory");
-
-		vkBindImageMemory(device, image, imageMemory, 0);
+		imageMemory = deviceAllocator.allocateImage(image, properties, tiling);
 	}
 
-	static auto createImageView(VkDevice device, VkImage image, VkFormat format)
+	static auto createImageView(VkDevice device, VkImage image, VkFormat format, std::uint32_t mipLevels = 1)
 	{
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -318,7 +283,7 @@ namespace vulkan
 		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
@@ -329,7 +294,9 @@ namespace vulkan
 		return imageView;
 	}
 
-	static auto createSampler(VkDevice device, VkPhysicalDevice physicalDevice)
+	// Lod range covers every level the texture has
+
+	static auto createSampler(VkDevice device, VkPhysicalDevice physicalDevice, std::uint32_t mipLevels = 1)
 	{
 		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -353,7 +320,7 @@ namespace vulkan
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(mipLevels);
 
 		VkSampler sampler;
 
@@ -363,11 +330,12 @@ namespace vulkan
 		return sampler;
 	}
 
-	static void copyBufferToImage(VkDevice device, VkQueue graphicsQueue, VkCommandPool commandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
+	static void copyBufferToImage(VkDevice device, VkQueue graphicsQueue, VkCommandPool commandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
+		VkDeviceSize bufferOffset = 0, VkFence fence = VK_NULL_HANDLE) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 
@@ -384,7 +352,7 @@ namespace vulkan
 		};
 
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		endSingleTimeCommands(device, graphicsQueue, commandPool, commandBuffer);
+		endSingleTimeCommands(device, graphicsQueue, commandPool, commandBuffer, fence);
 	}
 
 
@@ -434,38 +402,101 @@ namespace vulkan
 		endSingleTimeCommands(device, graphicsQueue, commandPool, commandBuffer);
 	}
 
-	static auto createTexture(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue, VkCommandPool commandPool, const std::string_view& path)
+	// Blitting mips down needs linear filtering & blits both ways on the format, otherwise they're made on the CPU when decoding
+
+	static auto canBlitMips(VkPhysicalDevice physicalDevice, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+		const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & needed) == needed;
+	}
+
+	// Image, view & sampler in the image's format with a full mip chain, nothing's recorded yet: the upload goes to transferQueue.copyImages,
+	// which blits whatever levels the image didn't come with
+
+	static auto stageTexture(VkDevice device, VkPhysicalDevice physicalDevice, const memory::DecodedImage& image)
 	{
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(path.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
+		types::Texture texture;
+		texture.mipLevels = image.mipLevels;
 
-		if (!pixels)
-			throw std::runtime_error("failed to load texture image!");
+		createImage(device, image.width, image.height, image.format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory, image.mipLevels);
 
-		const auto imageBufferInfo = createBuffer(device, physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		texture.view = createImageView(device, texture.image, image.format, image.mipLevels);
+		texture.sampler = createSampler(device, physicalDevice, image.mipLevels);
 
-		void* data;
-		vkMapMemory(device, std::get<1>(imageBufferInfo), 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(device, std::get<1>(imageBufferInfo));
+		return std::make_tuple(texture, memory::ImageUpload{ image.levels, texture.image, image.width, image.height, image.mipLevels });
+	}
 
-		stbi_image_free(pixels);
+	// Single level from RGBA8 pixels in memory
 
-		types::Texture texture;
+	static auto stageTexture(VkDevice device, VkPhysicalDevice physicalDevice, const void* pixels, std::uint32_t width, std::uint32_t height)
+	{
+		const VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4u;
+
+		memory::DecodedImage image;
+		image.width = width;
+		image.height = height;
+		image.mipLevels = 1u;
+		image.levels.push_back(stagingRing.allocate(imageSize, 4u));
+
+		memcpy(image.levels[0].mapped, pixels, static_cast<size_t>(imageSize));
+
+		return stageTexture(device, physicalDevice, image);
+	}
+
+	// All of them go out in one transfer submit without waiting, more only when they'd overrun the staging ring. texture.uploaded is the
+	// transfer timeline value each is usable at
+
+	static auto createTextures(VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<std::string>& paths)
+	{
+		std::vector<types::Texture> textures;
+		textures.reserve(paths.size());
 
-		createImage(device, physicalDevice, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+		std::vector<memory::ImageUpload> uploads;
+		VkDeviceSize staged{ 0u };
+		std::size_t pending{ 0u };
 
-		transitionImageLayout(device, graphicsQueue, commandPool, texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(device, graphicsQueue, commandPool, std::get<0>(imageBufferInfo), texture.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(device, graphicsQueue, commandPool, texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		const auto cpuMips = !canBlitMips(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB);
 
-		vkDestroyBuffer(device, std::get<0>(imageBufferInfo), nullptr);
-		vkFreeMemory(device, std::get<1>(imageBufferInfo), nullptr);
+		const auto flush = [&]()
+		{
+			transferQueue.copyImages(uploads);
+
+			for (const auto& upload : uploads)
+				for (const auto& level : upload.levels)
+					stagingRing.release(level);
+
+			const auto uploaded = transferQueue.submit();
+
+			for (; pending < textures.size(); pending++)
+				textures[pending].uploaded = uploaded;
+
+			uploads.clear();
+			staged = 0u;
+		};
+
+		for (const auto& path : paths)
+		{
+			const auto image = loadImage(path, physicalDevice, cpuMips);
+
+			// Half the ring per submit leaves the other half for the batch before it while the GPU reads it
+
+			if (staged && staged + image.size() > utils::stagingRingSize / 2u)
+				flush();
+
+			auto [texture, upload] = stageTexture(device, physicalDevice, image);
+
+			textures.push_back(texture);
+			uploads.push_back(upload);
+			staged += image.size();
+		}
 
-		texture.view = createImageView(device, texture.image, VK_FORMAT_R8G8B8A8_SRGB);
-		texture.sampler = createSampler(device, physicalDevice);
+		if (!uploads.empty())
+			flush();
 
-		return texture;
+		return textures;
 	}
 }
\ No newline at end of file
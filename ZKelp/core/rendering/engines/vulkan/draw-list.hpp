@@ -0,0 +1,102 @@
+/*
+*	Desc: Draw list
+*	Note: Draws are grouped in fixed buckets that each get a secondary command buffer, every change bumps the scene version & stamps it on the bucket it touched
+*/
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "../../../../utilities/utilFlags.hpp"
+#include "types/vtypes.hpp"
+
+#undef min
+#undef max
+
+namespace vulkan
+{
+	class DrawList
+	{
+		// Starts out with the one triangle in the vertex buffer
+
+		std::vector<types::DrawCommand> draws{ types::DrawCommand{} };
+		std::vector<std::uint64_t> bucketVersions{ 1u }; // Scene version of each bucket's last change
+		std::uint64_t version{ 1u };
+
+		void touch(std::size_t index)
+		{
+			bucketVersions.resize(bucketCount(), version);
+			bucketVersions[index / utils::drawsPerSecondary] = version;
+		}
+
+	public:
+		// Everything changes
+
+		void assign(std::vector<types::DrawCommand> commands)
+		{
+			draws = std::move(commands);
+
+			version++;
+			bucketVersions.assign(bucketCount(), version);
+		}
+
+		// Every bucket gets recorded again, same draws
+
+		void invalidate()
+		{
+			version++;
+			bucketVersions.assign(bucketCount(), version);
+		}
+
+		// Only the draw's bucket gets recorded again
+
+		void update(std::size_t index, const types::DrawCommand& command)
+		{
+			draws[index] = command;
+
+			version++;
+			touch(index);
+		}
+
+		std::size_t add(const types::DrawCommand& command)
+		{
+			draws.push_back(command);
+
+			version++;
+			touch(draws.size() - 1u);
+			return draws.size() - 1u;
+		}
+
+		std::uint64_t sceneVersion() const
+		{
+			return version;
+		}
+
+		std::size_t size() const
+		{
+			return draws.size();
+		}
+
+		std::size_t bucketCount() const
+		{
+			return (draws.size() + utils::drawsPerSecondary - 1u) / utils::drawsPerSecondary;
+		}
+
+		std::uint64_t bucketVersion(std::size_t bucket) const
+		{
+			return bucketVersions[bucket];
+		}
+
+		const types::DrawCommand* bucketDraws(std::size_t bucket) const
+		{
+			return draws.data() + bucket * utils::drawsPerSecondary;
+		}
+
+		std::size_t bucketSize(std::size_t bucket) const
+		{
+			return std::min<std::size_t>(utils::drawsPerSecondary, draws.size() - bucket * utils::drawsPerSecondary);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,443 @@
+/*
+*	Desc: Device memory allocator
+*	Note: Buffers & images are sub-allocated out of big blocks per memory type (buddy system), drivers only allow a few thousand vkAllocateMemory calls
+*/
+#pragma once
+#include <set>
+#include <mutex>
+#include <array>
+#include <bit>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../../utilities/utilFlags.hpp"
+#include "../../../../../utilities/console/err.hpp"
+#include "../../../../../utilities/console/logger.hpp"
+#include "../types/vtypes.hpp"
+
+#undef min
+#undef max
+
+namespace vulkan
+{
+	namespace memory
+	{
+		constexpr VkDeviceSize minimumNodeSize{ 256u }; // Smallest piece a block is split into, covers every uniform & storage alignment out there
+
+		// Buffers & linear images never share a block with optimal images, so bufferImageGranularity can't put them on the same page
+
+		enum class ResourceKind : std::uint32_t
+		{
+			linear,
+			optimal
+		};
+
+		// One vkAllocateMemory, split in halves down to whatever size was asked for. Level 0 is the whole block, every level down halves the node size
+
+		struct Block
+		{
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			VkDeviceSize size{ 0u };
+			void* mapped{ nullptr };
+
+			std::vector<std::set<VkDeviceSize>> freeNodes; // Free node offsets per level
+			std::uint32_t allocations{ 0u };
+		};
+
+		struct Pool
+		{
+			std::vector<Block> blocks; // Freed blocks keep their slot (null memory), allocations point at it by index
+		};
+
+		struct TypeStats
+		{
+			std::uint32_t blockCount{ 0u };
+			VkDeviceSize blockBytes{ 0u };
+
+			std::uint32_t dedicatedCount{ 0u };
+			VkDeviceSize dedicatedBytes{ 0u };
+
+			std::uint32_t allocationCount{ 0u };
+			VkDeviceSize usedBytes{ 0u };		// What was asked for
+			VkDeviceSize reservedBytes{ 0u };	// What the buddy nodes actually take, the difference is internal fragmentation
+		};
+
+		struct Stats
+		{
+			std::array<TypeStats, VK_MAX_MEMORY_TYPES> types;
+
+			std::uint32_t deviceAllocations{ 0u };		// Live vkAllocateMemory calls, the thing drivers cap
+			std::uint32_t peakDeviceAllocations{ 0u };
+			std::uint32_t maxDeviceAllocations{ 0u };
+		};
+	}
+
+	class DeviceAllocator
+	{
+		VkDevice device{ VK_NULL_HANDLE };
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+		VkDeviceSize bufferImageGranularity{ 1u };
+		bool dedicatedInfo{ false }; // VkMemoryDedicatedAllocateInfo is core from 1.1
+
+		std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> blockSizes{};
+		std::array<memory::Pool, VK_MAX_MEMORY_TYPES * 2> pools;
+
+		memory::Stats stats;
+		std::mutex lock;
+
+		static auto poolIndex(std::uint32_t memoryType, memory::ResourceKind kind)
+		{
+			return memoryType * 2u + static_cast<std::uint32_t>(kind);
+		}
+
+		bool hostVisible(std::uint32_t memoryType)
+		{
+			return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		}
+
+		VkDeviceMemory allocateDevice(std::uint32_t memoryType, VkDeviceSize size, VkImage dedicatedImage = VK_NULL_HANDLE, VkBuffer dedicatedBuffer = VK_NULL_HANDLE)
+		{
+			if (stats.maxDeviceAllocations && stats.deviceAllocations >= stats.maxDeviceAllocations)
+				throw err::err("ran out of device memory allocations");
+
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = size;
+			allocInfo.memoryTypeIndex = memoryType;
+
+			VkMemoryDedicatedAllocateInfo dedicatedAllocInfo = {};
+			dedicatedAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+			dedicatedAllocInfo.image = dedicatedImage;
+			dedicatedAllocInfo.buffer = dedicatedBuffer;
+
+			if (dedicatedInfo && (dedicatedImage != VK_NULL_HANDLE || dedicatedBuffer != VK_NULL_HANDLE))
+				allocInfo.pNext = &dedicatedAllocInfo;
+
+			VkDeviceMemory deviceMemory;
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &deviceMemory) != VK_SUCCESS)
+				throw err::err("failed to allocate device memory");
+
+			stats.deviceAllocations++;
+			stats.peakDeviceAllocations = std::max(stats.peakDeviceAllocations, stats.deviceAllocations);
+			return deviceMemory;
+		}
+
+		void freeDevice(VkDeviceMemory deviceMemory)
+		{
+			vkFreeMemory(device, deviceMemory, nullptr);
+			stats.deviceAllocations--;
+		}
+
+		static std::uint32_t levelCount(VkDeviceSize blockSize)
+		{
+			return static_cast<std::uint32_t>(std::countr_zero(blockSize / memory::minimumNodeSize)) + 1u;
+		}
+
+		// Index of a block with a free node at the level (or above it), a new block when none has one
+
+		std::uint32_t findBlock(memory::Pool& pool, std::uint32_t memoryType, std::uint32_t level)
+		{
+			for (auto i = 0u; i < pool.blocks.size(); i++)
+			{
+				const auto& block = pool.blocks[i];
+				if (block.memory == VK_NULL_HANDLE)
+					continue;
+
+				for (auto candidate = 0u; candidate <= level; candidate++)
+					if (!block.freeNodes[candidate].empty())
+						return i;
+			}
+
+			memory::Block block;
+			block.size = blockSizes[memoryType];
+			block.memory = allocateDevice(memoryType, block.size);
+			block.freeNodes.resize(levelCount(block.size));
+			block.freeNodes[0].insert(0u);
+
+			// Host visible blocks stay mapped as a whole, a memory object can only be mapped once
+
+			if (hostVisible(memoryType) && vkMapMemory(device, block.memory, 0, block.size, 0, &block.mapped) != VK_SUCCESS)
+				throw err::err("failed to map a host visible memory block");
+
+			stats.types[memoryType].blockCount++;
+			stats.types[memoryType].blockBytes += block.size;
+
+			// Reuse a freed slot so indices held by live allocations stay put
+
+			for (auto i = 0u; i < pool.blocks.size(); i++)
+				if (pool.blocks[i].memory == VK_NULL_HANDLE)
+				{
+					pool.blocks[i] = std::move(block);
+					return i;
+				}
+
+			pool.blocks.push_back(std::move(block));
+			return static_cast<std::uint32_t>(pool.blocks.size() - 1u);
+		}
+
+	public:
+		void init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice)
+		{
+			device = logicalDevice;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+			bufferImageGranularity = properties.limits.bufferImageGranularity;
+			dedicatedInfo = properties.apiVersion >= VK_API_VERSION_1_1;
+
+			stats = {};
+			stats.maxDeviceAllocations = properties.limits.maxMemoryAllocationCount;
+
+			// Small heaps (integrated GPUs, the 256MB BAR heap) get smaller blocks so one block doesn't eat a big share of them
+
+			for (auto i = 0u; i < memoryProperties.memoryTypeCount; i++)
+			{
+				const auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+				const auto blockSize = std::min<VkDeviceSize>(utils::deviceMemoryBlockSize, std::bit_floor(std::max<VkDeviceSize>(heapSize / 8u, memory::minimumNodeSize)));
+
+				blockSizes[i] = std::max(blockSize, memory::minimumNodeSize);
+			}
+		}
+
+		std::uint32_t findMemoryType(std::uint32_t typeBits, VkMemoryPropertyFlags properties)
+		{
+			for (auto i = 0u; i < memoryProperties.memoryTypeCount; i++)
+				if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+					return i;
+
+			throw err::err("failed to find memory type");
+		}
+
+		bool hasMemoryType(std::uint32_t typeBits, VkMemoryPropertyFlags properties)
+		{
+			for (auto i = 0u; i < memoryProperties.memoryTypeCount; i++)
+				if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+					return true;
+
+			return false;
+		}
+
+		// Big images & anything that doesn't fit a block get their own allocation
+
+		types::Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, memory::ResourceKind kind,
+			VkImage image = VK_NULL_HANDLE, VkBuffer buffer = VK_NULL_HANDLE)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			const auto memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+			const auto blockSize = blockSizes[memoryType];
+
+			// Buddy nodes are aligned to their own size, so rounding up to the alignment is all it takes
+
+			const auto nodeSize = std::bit_ceil(std::max({ requirements.size, requirements.alignment, memory::minimumNodeSize }));
+
+			types::Allocation allocation;
+			allocation.memoryType = memoryType;
+			allocation.size = requirements.size;
+
+			auto& typeStats = stats.types[memoryType];
+
+			if (nodeSize > blockSize || (kind == memory::ResourceKind::optimal && nodeSize >= blockSize / 4u))
+			{
+				allocation.memory = allocateDevice(memoryType, requirements.size, image, buffer);
+				allocation.dedicated = true;
+
+				if (hostVisible(memoryType) && vkMapMemory(device, allocation.memory, 0, requirements.size, 0, &allocation.mapped) != VK_SUCCESS)
+					throw err::err("failed to map a dedicated allocation");
+
+				typeStats.dedicatedCount++;
+				typeStats.dedicatedBytes += requirements.size;
+				return allocation;
+			}
+
+			const auto level = static_cast<std::uint32_t>(std::countr_zero(blockSize / nodeSize));
+
+			allocation.pool = poolIndex(memoryType, kind);
+			allocation.block = findBlock(pools[allocation.pool], memoryType, level);
+			allocation.level = level;
+
+			auto& block = pools[allocation.pool].blocks[allocation.block];
+
+			// Take the smallest free node that fits & split it down, the upper halves go back on the free lists
+
+			auto from = level;
+			while (block.freeNodes[from].empty())
+				from--;
+
+			const auto offset = *block.freeNodes[from].begin();
+			block.freeNodes[from].erase(block.freeNodes[from].begin());
+
+			for (auto split = from; split < level; split++)
+				block.freeNodes[split + 1u].insert(offset + (block.size >> (split + 1u)));
+
+			block.allocations++;
+
+			allocation.memory = block.memory;
+			allocation.offset = offset;
+			allocation.mapped = block.mapped ? static_cast<std::uint8_t*>(block.mapped) + offset : nullptr;
+
+			typeStats.allocationCount++;
+			typeStats.usedBytes += requirements.size;
+			typeStats.reservedBytes += nodeSize;
+
+			return allocation;
+		}
+
+		types::Allocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+		{
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+			const auto allocation = allocate(requirements, properties, memory::ResourceKind::linear, VK_NULL_HANDLE, buffer);
+
+			if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+				throw err::err("failed to bind buffer memory");
+			return allocation;
+		}
+
+		types::Allocation allocateImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL)
+		{
+			VkMemoryRequirements requirements;
+			vkGetImageMemoryRequirements(device, image, &requirements);
+
+			// Linear images are fine next to buffers, as long as they're granularity aligned
+
+			auto kind{ memory::ResourceKind::optimal };
+			if (tiling == VK_IMAGE_TILING_LINEAR)
+			{
+				kind = memory::ResourceKind::linear;
+				requirements.alignment = std::max(requirements.alignment, bufferImageGranularity);
+			}
+
+			const auto allocation = allocate(requirements, properties, kind, image);
+
+			if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+				throw err::err("failed to bind image memory");
+			return allocation;
+		}
+
+		void free(types::Allocation& allocation)
+		{
+			if (allocation.memory == VK_NULL_HANDLE)
+				return;
+
+			std::lock_guard<std::mutex> guard(lock);
+
+			auto& typeStats = stats.types[allocation.memoryType];
+
+			if (allocation.dedicated)
+			{
+				freeDevice(allocation.memory);
+
+				typeStats.dedicatedCount--;
+				typeStats.dedicatedBytes -= allocation.size;
+				allocation = {};
+				return;
+			}
+
+			auto& pool = pools[allocation.pool];
+			auto& block = pool.blocks[allocation.block];
+
+			// Merge with the buddy for as long as it's free too
+
+			auto offset = allocation.offset;
+			auto level = allocation.level;
+
+			while (level > 0u)
+			{
+				const auto buddy = offset ^ (block.size >> level);
+				if (!block.freeNodes[level].erase(buddy))
+					break;
+
+				offset = std::min(offset, buddy);
+				level--;
+			}
+
+			block.freeNodes[level].insert(offset);
+			block.allocations--;
+
+			typeStats.allocationCount--;
+			typeStats.usedBytes -= allocation.size;
+			typeStats.reservedBytes -= block.size >> allocation.level;
+
+			// Give empty blocks back, but keep one around per pool so a load/unload loop doesn't thrash vkAllocateMemory
+
+			if (!block.allocations)
+			{
+				const auto liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const memory::Block& candidate) { return candidate.memory != VK_NULL_HANDLE; });
+
+				if (liveBlocks > 1)
+				{
+					freeDevice(block.memory);
+
+					typeStats.blockCount--;
+					typeStats.blockBytes -= block.size;
+					block = {};
+				}
+			}
+
+			allocation = {};
+		}
+
+		memory::Stats getStats()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return stats;
+		}
+
+		void logStats()
+		{
+			const auto current = getStats();
+			const auto mega = [](VkDeviceSize bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+			logger.log("device memory | %u vkAllocateMemory live (peak %u, limit %u)\n", current.deviceAllocations, current.peakDeviceAllocations, current.maxDeviceAllocations);
+
+			for (auto i = 0u; i < memoryProperties.memoryTypeCount; i++)
+			{
+				const auto& type = current.types[i];
+				if (!type.blockCount && !type.dedicatedCount)
+					continue;
+
+				logger.log("device memory | type %u | %u blocks %.1fMB | %u allocations, %.1fMB used %.1fMB reserved | %u dedicated %.1fMB\n", i,
+					type.blockCount, mega(type.blockBytes), type.allocationCount, mega(type.usedBytes), mega(type.reservedBytes), type.dedicatedCount, mega(type.dedicatedBytes));
+			}
+		}
+
+		// Everything should've been freed by now, whatever wasn't goes with its block
+
+		void destroy()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			for (auto& pool : pools)
+			{
+				for (auto& block : pool.blocks)
+				{
+					if (block.memory == VK_NULL_HANDLE)
+						continue;
+
+					if (block.allocations)
+						logger.log("device memory | %u allocations leaked in a block\n", block.allocations);
+
+					freeDevice(block.memory);
+				}
+
+				pool.blocks.clear();
+			}
+
+			if (stats.deviceAllocations)
+				logger.log("device memory | %u dedicated allocations leaked\n", stats.deviceAllocations);
+
+			device = VK_NULL_HANDLE;
+		}
+	};
+
+	static DeviceAllocator deviceAllocator;
+}
\ No newline at end of file
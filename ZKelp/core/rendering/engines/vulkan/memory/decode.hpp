@@ -0,0 +1,275 @@
+/*
+*	Desc: Image decoding
+*	Note: stb_image's allocations are hooked so the decoded image lands right in a held staging slice, mips get box filtered here when the GPU can't blit them
+*/
+#pragma once
+#include <bit>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../../utilities/utilFlags.hpp"
+#include "../../../../../utilities/console/err.hpp"
+#include "staging.hpp"
+
+namespace vulkan
+{
+	namespace decode
+	{
+		// Spot reserved for the output of the decode running on this thread
+
+		struct DecodeTarget
+		{
+			void* memory{ nullptr };
+			std::size_t size{ 0u };
+			bool taken{ false };
+		};
+
+		static inline thread_local DecodeTarget target;
+
+		// The output is the only allocation stb makes of exactly width * height * 4, anything else (or a second one) is a normal malloc
+
+		static void* allocate(std::size_t size)
+		{
+			if (target.memory != nullptr && !target.taken && size == target.size)
+			{
+				target.taken = true;
+				return target.memory;
+			}
+
+			return malloc(size);
+		}
+
+		static void* reallocate(void* pointer, std::size_t oldSize, std::size_t newSize)
+		{
+			if (pointer == nullptr || pointer != target.memory)
+				return realloc(pointer, newSize);
+
+			// Outgrew it, moves off to the heap & the result gets copied over at the end
+
+			const auto moved = malloc(newSize);
+			if (moved != nullptr)
+				memcpy(moved, pointer, std::min(oldSize, newSize));
+			return moved;
+		}
+
+		static void release(void* pointer)
+		{
+			if (pointer != nullptr && pointer == target.memory)
+				return;
+
+			free(pointer);
+		}
+	}
+}
+
+#define STBI_MALLOC(size) vulkan::decode::allocate(size)
+#define STBI_REALLOC(pointer, size) vulkan::decode::reallocate(pointer, 0u, size)
+#define STBI_REALLOC_SIZED(pointer, oldSize, newSize) vulkan::decode::reallocate(pointer, oldSize, newSize)
+#define STBI_FREE(pointer) vulkan::decode::release(pointer)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../../../../3rd party/stb/image.hpp"
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// RGBA8 levels sitting in staging (the first is the full image), the slices are held until the copies reading them are recorded.
+		// Anything past the levels given still has to be made from the last one
+
+		struct DecodedImage
+		{
+			std::vector<StagingSlice> levels;
+			VkFormat format{ VK_FORMAT_R8G8B8A8_SRGB };
+			std::uint32_t width{ 0u };
+			std::uint32_t height{ 0u };
+			std::uint32_t mipLevels{ 1u };
+
+			VkDeviceSize size() const
+			{
+				VkDeviceSize total{ 0u };
+				for (const auto& level : levels)
+					total += level.size;
+				return total;
+			}
+		};
+	}
+
+	namespace decode
+	{
+		// Full chain down to 1x1
+
+		static std::uint32_t mipLevelCount(std::uint32_t width, std::uint32_t height)
+		{
+			return static_cast<std::uint32_t>(std::bit_width(std::max(width, height)));
+		}
+
+		// 2x2 box filter, odd edges drop their last row / column like the blits do. Averages pairs of pairs, so it can round up by one
+
+		static void downsample(const std::uint8_t* source, std::uint32_t width, std::uint32_t height, std::uint8_t* destination)
+		{
+			const auto outWidth = std::max(width / 2u, 1u);
+			const auto outHeight = std::max(height / 2u, 1u);
+			const auto stride = static_cast<std::size_t>(width) * 4u;
+
+			for (auto y = 0u; y < outHeight; y++)
+			{
+				const auto top = source + static_cast<std::size_t>(std::min(y * 2u, height - 1u)) * stride;
+				const auto bottom = source + static_cast<std::size_t>(std::min(y * 2u + 1u, height - 1u)) * stride;
+				const auto out = destination + static_cast<std::size_t>(y) * outWidth * 4u;
+
+				auto x = 0u;
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+				// Four pixels out of eight at a time, rows first then the even & odd columns
+
+				if (width >= 2u)
+				{
+					for (; x + 4u <= outWidth; x += 4u)
+					{
+						const auto rows0 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + x * 8u)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + x * 8u)));
+						const auto rows1 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + x * 8u + 16u)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + x * 8u + 16u)));
+
+						const auto even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(rows0), _mm_castsi128_ps(rows1), _MM_SHUFFLE(2, 0, 2, 0)));
+						const auto odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(rows0), _mm_castsi128_ps(rows1), _MM_SHUFFLE(3, 1, 3, 1)));
+
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4u), _mm_avg_epu8(even, odd));
+					}
+				}
+#endif
+
+				for (; x < outWidth; x++)
+				{
+					const auto left = std::min(x * 2u, width - 1u) * 4u;
+					const auto right = std::min(x * 2u + 1u, width - 1u) * 4u;
+
+					for (auto channel = 0u; channel < 4u; channel++)
+						out[x * 4u + channel] = static_cast<std::uint8_t>((top[left + channel] + top[right + channel] + bottom[left + channel] + bottom[right + channel] + 2u) / 4u);
+				}
+			}
+		}
+
+		// One image file into a held slice, the output is hooked straight into it
+
+		static auto decodeLevel(const std::string& path)
+		{
+			int width, height, channels;
+			if (!stbi_info(path.c_str(), &width, &height, &channels))
+				throw err::err("failed to load texture image {}", path);
+
+			const auto size = static_cast<VkDeviceSize>(width) * height * 4u;
+
+			// Texel copies want the offset aligned to the texel size (4 here)
+
+			const auto staging = stagingRing.allocate(size, 4u, true);
+			target = { staging.mapped, static_cast<std::size_t>(size), false };
+
+			stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+			target = {};
+
+			if (!pixels)
+			{
+				stagingRing.release(staging);
+				throw err::err("failed to load texture image {}", path);
+			}
+
+			// The output went around the hook (it got realloc'd), copied over after all
+
+			if (pixels != staging.mapped)
+			{
+				memcpy(staging.mapped, pixels, static_cast<size_t>(size));
+				stbi_image_free(pixels);
+			}
+
+			return std::make_tuple(staging, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height));
+		}
+	}
+
+	// Safe on any thread, release every level's slice once the copies are recorded. With utils::precomputedMips the levels come from
+	// "<name>.mip1<ext>" onwards for as long as those exist & have the right size, cpuMips makes whatever's left here instead of on the GPU
+
+	static auto decodeImage(const std::string& path, bool cpuMips)
+	{
+		memory::DecodedImage image;
+		memory::HeldSlices held(image.levels);
+
+		// Room for any level count up front, a push_back that throws would lose the slice it was handed
+
+		image.levels.reserve(32u);
+
+		const auto [base, width, height] = decode::decodeLevel(path);
+
+		image.levels.push_back(base);
+		image.width = width;
+		image.height = height;
+		image.mipLevels = decode::mipLevelCount(width, height);
+
+		if (utils::precomputedMips)
+		{
+			const std::filesystem::path source(path);
+
+			for (auto level = 1u; level < image.mipLevels; level++)
+			{
+				auto mipPath = source;
+				mipPath.replace_extension(".mip" + std::to_string(level) + source.extension().string());
+
+				std::error_code error;
+				if (!std::filesystem::exists(mipPath, error))
+					break;
+
+				memory::StagingSlice mip;
+				std::uint32_t mipWidth, mipHeight;
+
+				// A broken mip just ends the chain there, the base level is still good
+
+				try
+				{
+					std::tie(mip, mipWidth, mipHeight) = decode::decodeLevel(mipPath.string());
+				}
+				catch (err::err&)
+				{
+					break;
+				}
+
+				if (mipWidth != std::max(width >> level, 1u) || mipHeight != std::max(height >> level, 1u))
+				{
+					stagingRing.release(mip);
+					break;
+				}
+
+				image.levels.push_back(mip);
+			}
+		}
+
+		if (cpuMips)
+		{
+			for (auto level = static_cast<std::uint32_t>(image.levels.size()); level < image.mipLevels; level++)
+			{
+				const auto& above = image.levels.back();
+				const auto aboveWidth = std::max(width >> (level - 1u), 1u);
+				const auto aboveHeight = std::max(height >> (level - 1u), 1u);
+
+				const auto mip = stagingRing.allocate(static_cast<VkDeviceSize>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4u, 4u, true);
+				decode::downsample(static_cast<const std::uint8_t*>(above.mapped), aboveWidth, aboveHeight, static_cast<std::uint8_t*>(mip.mapped));
+
+				image.levels.push_back(mip);
+			}
+		}
+
+		held.dismiss();
+		return image;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+/*
+*	Desc: KTX2 textures
+*	Note: Block compressed levels are copied out of the mapped file into staging as they are, nothing gets decoded on the CPU
+*/
+#pragma once
+#include <array>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../../utilities/files/fs.hpp"
+#include "../../../../../utilities/console/err.hpp"
+#include "decode.hpp"
+
+#undef min
+#undef max
+
+namespace vulkan
+{
+	namespace ktx2
+	{
+		constexpr std::array<std::uint8_t, 12> identifier{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct Header
+		{
+			std::uint8_t identifier[12];
+			std::uint32_t vkFormat;
+			std::uint32_t typeSize;
+			std::uint32_t pixelWidth;
+			std::uint32_t pixelHeight;
+			std::uint32_t pixelDepth;
+			std::uint32_t layerCount;
+			std::uint32_t faceCount;
+			std::uint32_t levelCount;
+			std::uint32_t supercompressionScheme;
+
+			std::uint32_t dfdByteOffset;
+			std::uint32_t dfdByteLength;
+			std::uint32_t kvdByteOffset;
+			std::uint32_t kvdByteLength;
+			std::uint64_t sgdByteOffset;
+			std::uint64_t sgdByteLength;
+		};
+
+		struct LevelIndex
+		{
+			std::uint64_t byteOffset;
+			std::uint64_t byteLength;
+			std::uint64_t uncompressedByteLength;
+		};
+
+		static_assert(sizeof(Header) == 80 && sizeof(LevelIndex) == 24, "KTX2 header layout");
+
+		// Texels per block each way & bytes per block
+
+		struct BlockInfo
+		{
+			std::uint32_t width{ 1u };
+			std::uint32_t height{ 1u };
+			std::uint32_t bytes{ 4u };
+		};
+
+		// Formats we know how to size, anything else is turned away
+
+		static std::optional<BlockInfo> blockInfo(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				return BlockInfo{ 1u, 1u, 4u };
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return BlockInfo{ 4u, 4u, 8u };
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+			case VK_FORMAT_BC5_SNORM_BLOCK:
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return BlockInfo{ 4u, 4u, 16u };
+			default:
+				break;
+			}
+
+			// ASTC comes in UNORM / SRGB pairs, every block is 16 bytes
+
+			if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+			{
+				constexpr std::uint32_t footprints[14][2]{ { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+				const auto& footprint = footprints[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+				return BlockInfo{ footprint[0], footprint[1], 16u };
+			}
+
+			return {};
+		}
+
+		// Sampled straight from optimal tiling & copied into (BC & ASTC also need their device feature, which is on whenever it's there)
+
+		static bool formatSupported(VkPhysicalDevice physicalDevice, VkFormat format)
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+			const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+			return (formatProperties.optimalTilingFeatures & needed) == needed;
+		}
+
+		static std::uint64_t levelSize(const BlockInfo& block, std::uint32_t width, std::uint32_t height)
+		{
+			return static_cast<std::uint64_t>((width + block.width - 1u) / block.width) * ((height + block.height - 1u) / block.height) * block.bytes;
+		}
+
+		// Header checked against the file, throws on anything we can't upload as it is
+
+		static auto readHeader(const fs::MappedFile& file, const std::string& path)
+		{
+			if (file.data() == nullptr || file.size() < sizeof(Header))
+				throw err::err("failed to load texture image {}", path);
+
+			Header header;
+			memcpy(&header, file.data(), sizeof(Header));
+
+			if (!std::equal(identifier.begin(), identifier.end(), header.identifier))
+				throw err::err("{} isn't a KTX2 file", path);
+
+			if (header.pixelDepth > 1u || header.layerCount > 1u || header.faceCount != 1u || !header.pixelWidth || !header.pixelHeight)
+				throw err::err("{} isn't a plain 2D texture", path);
+
+			if (header.supercompressionScheme != 0u)
+				throw err::err("{} is supercompressed, only raw KTX2 is loaded", path);
+
+			if (sizeof(Header) + static_cast<std::uint64_t>(std::max(header.levelCount, 1u)) * sizeof(LevelIndex) > file.size())
+				throw err::err("{} is cut short", path);
+
+			return header;
+		}
+	}
+
+	// Levels go into held slices like decodeImage's, release them once the copies are recorded. The file only says how many levels it has,
+	// compressed formats can't be blitted so that's all the texture gets
+
+	static auto loadKtx2(const std::string& path, VkPhysicalDevice physicalDevice)
+	{
+		const fs::MappedFile file(path);
+		const auto header = ktx2::readHeader(file, path);
+
+		const auto format = static_cast<VkFormat>(header.vkFormat);
+		const auto block = ktx2::blockInfo(format);
+
+		if (!block.has_value())
+			throw err::err("{} has a format we don't load ({})", path, header.vkFormat);
+
+		if (!ktx2::formatSupported(physicalDevice, format))
+			throw err::err("{} has a format this device can't sample ({})", path, header.vkFormat);
+
+		memory::DecodedImage image;
+		image.format = format;
+		image.width = header.pixelWidth;
+		image.height = header.pixelHeight;
+		image.mipLevels = std::min(std::max(header.levelCount, 1u), decode::mipLevelCount(image.width, image.height));
+
+		memory::HeldSlices held(image.levels);
+		image.levels.reserve(image.mipLevels);
+
+		for (auto level = 0u; level < image.mipLevels; level++)
+		{
+			ktx2::LevelIndex index;
+			memcpy(&index, file.data() + sizeof(ktx2::Header) + level * sizeof(ktx2::LevelIndex), sizeof(ktx2::LevelIndex));
+
+			const auto expected = ktx2::levelSize(block.value(), std::max(image.width >> level, 1u), std::max(image.height >> level, 1u));
+
+			if (index.byteLength != expected || index.byteOffset > file.size() || index.byteLength > file.size() - index.byteOffset)
+				throw err::err("{} has a broken level {}", path, level);
+
+			// Copy offsets have to land on a whole block
+
+			auto staging = stagingRing.allocate(expected, 16u, true);
+			memcpy(staging.mapped, file.data() + index.byteOffset, static_cast<size_t>(expected));
+
+			image.levels.push_back(staging);
+		}
+
+		held.dismiss();
+		return image;
+	}
+
+	// Any texture path, a KTX2 next to an image ("<name>.ktx2") is taken instead when this device can sample its format. Safe on any thread
+
+	static auto loadImage(const std::string& path, VkPhysicalDevice physicalDevice, bool cpuMips)
+	{
+		const std::filesystem::path source(path);
+
+		if (source.extension() == ".ktx2")
+			return loadKtx2(path, physicalDevice);
+
+		auto compressed = source;
+		compressed.replace_extension(".ktx2");
+
+		std::error_code error;
+		if (std::filesystem::exists(compressed, error))
+		{
+			try
+			{
+				return loadKtx2(compressed.string(), physicalDevice);
+			}
+			catch (err::err&)
+			{
+				// Falls back to decoding the original
+			}
+		}
+
+		return decodeImage(path, cpuMips);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,357 @@
+/*
+*	Desc: Staging ring
+*	Note: One persistently mapped host buffer every upload is copied through, space comes back once the fence of the submit that read it signals
+*/
+#pragma once
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../../utilities/utilFlags.hpp"
+#include "../../../../../utilities/console/err.hpp"
+#include "../types/vtypes.hpp"
+#include "allocator.hpp"
+
+#undef min
+#undef max
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// Where an upload's bytes go, copy from buffer at offset once they're written
+
+		struct StagingSlice
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkDeviceSize offset{ 0u };
+			VkDeviceSize size{ 0u };
+			void* mapped{ nullptr };
+		};
+
+		// Everything staged between two submits, it's all done once the fence is
+
+		struct StagingBatch
+		{
+			VkDeviceSize end{ 0u };
+			VkFence fence{ VK_NULL_HANDLE };
+
+			std::vector<std::tuple<VkBuffer, types::Allocation>> oversized; // Uploads bigger than the ring get a buffer of their own, gone with the batch
+		};
+	}
+
+	class StagingRing
+	{
+		VkDevice device{ VK_NULL_HANDLE };
+
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		types::Allocation memory;
+		VkDeviceSize capacity{ 0u };
+		VkMemoryPropertyFlags properties{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+
+		// Used space runs from tail to head (wrapping), head == tail is empty only when nothing's staged
+
+		VkDeviceSize head{ 0u };
+		VkDeviceSize tail{ 0u };
+
+		std::deque<memory::StagingBatch> batches;
+		memory::StagingBatch open;
+		std::uint32_t openSlices{ 0u };
+
+		// Held slices are still being written off the render thread, no batch may end past the oldest one until it's released
+
+		std::deque<VkDeviceSize> held;
+		std::vector<std::tuple<VkBuffer, types::Allocation>> heldOversized;
+
+		std::vector<VkFence> freeFences;
+		std::mutex lock;
+
+		void retire(memory::StagingBatch& batch)
+		{
+			for (auto& [oversizedBuffer, oversizedMemory] : batch.oversized)
+			{
+				vkDestroyBuffer(device, oversizedBuffer, nullptr);
+				deviceAllocator.free(oversizedMemory);
+			}
+
+			freeFences.push_back(batch.fence);
+		}
+
+		// Pops every batch the GPU is done with, oldest first
+
+		void reclaim(bool waitOldest)
+		{
+			while (!batches.empty())
+			{
+				auto& oldest = batches.front();
+
+				if (waitOldest)
+				{
+					vkWaitForFences(device, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+					waitOldest = false;
+				}
+				else if (vkGetFenceStatus(device, oldest.fence) != VK_SUCCESS)
+				{
+					break;
+				}
+
+				tail = oldest.end;
+				retire(oldest);
+				batches.pop_front();
+			}
+
+			if (batches.empty() && !openSlices && held.empty())
+				head = tail = 0u;
+		}
+
+		memory::StagingSlice oversized(VkDeviceSize size, bool hold)
+		{
+			memory::StagingSlice slice;
+			slice.size = size;
+
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &slice.buffer) != VK_SUCCESS)
+				throw err::err("failed to create an oversized staging buffer");
+
+			const auto oversizedMemory = deviceAllocator.allocateBuffer(slice.buffer, properties);
+
+			slice.mapped = oversizedMemory.mapped;
+			(hold ? heldOversized : open.oversized).push_back(std::make_tuple(slice.buffer, oversizedMemory));
+			return slice;
+		}
+
+		std::optional<VkDeviceSize> fit(VkDeviceSize size, VkDeviceSize alignment)
+		{
+			const auto empty = batches.empty() && !openSlices && held.empty();
+			const auto offset = (head + alignment - 1u) / alignment * alignment;
+
+			if (empty || head > tail)
+			{
+				if (offset + size <= capacity)
+					return offset;
+
+				// Wrap around, whatever's left at the end is skipped until the tail passes it
+
+				if (size <= tail)
+					return VkDeviceSize{ 0u };
+			}
+			else if (head < tail && offset + size <= tail)
+			{
+				return offset;
+			}
+
+			return {};
+		}
+
+	public:
+		void init(VkDevice logicalDevice, VkDeviceSize size)
+		{
+			device = logicalDevice;
+			capacity = size;
+			head = tail = 0u;
+
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+				throw err::err("failed to create the staging ring");
+
+			// Images get decoded right into the ring & decoders read back what they wrote, that's slow on uncached (write-combined) memory
+
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+			properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			if (deviceAllocator.hasMemoryType(requirements.memoryTypeBits, properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+				properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+			memory = deviceAllocator.allocateBuffer(buffer, properties);
+		}
+
+		// Blocks only when the ring's full of uploads the GPU hasn't gotten to yet. A held slice can be filled from any thread, it's only
+		// part of a batch once it's released (after its copy got recorded)
+
+		memory::StagingSlice allocate(VkDeviceSize size, VkDeviceSize alignment = 16u, bool hold = false)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			if (size > capacity)
+				return oversized(size, hold);
+
+			reclaim(false);
+
+			auto offset = fit(size, alignment);
+			while (!offset.has_value())
+			{
+				// Whatever's left is still being written or not submitted yet, nothing to wait on. Off the render thread that's
+				// no reason to fail, it just gets a buffer of its own
+
+				if (batches.empty())
+				{
+					if (hold || !held.empty())
+						return oversized(size, hold);
+
+					throw err::err("staging ring is too small for what's staged before one submit, raise utils::stagingRingSize");
+				}
+
+				reclaim(true);
+				offset = fit(size, alignment);
+			}
+
+			head = offset.value() + size;
+
+			if (hold)
+				held.push_back(offset.value());
+			else
+				openSlices++;
+
+			memory::StagingSlice slice;
+			slice.buffer = buffer;
+			slice.offset = offset.value();
+			slice.size = size;
+			slice.mapped = static_cast<std::uint8_t*>(memory.mapped) + offset.value();
+			return slice;
+		}
+
+		// Hands a held slice over to the open batch, call it once the copy reading it is recorded (or it's given up on)
+
+		void release(const memory::StagingSlice& slice)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			if (slice.buffer != buffer)
+			{
+				const auto found = std::find_if(heldOversized.begin(), heldOversized.end(), [&](const auto& entry) { return std::get<0>(entry) == slice.buffer; });
+				if (found == heldOversized.end())
+					return;
+
+				open.oversized.push_back(*found);
+				heldOversized.erase(found);
+				return;
+			}
+
+			const auto found = std::find(held.begin(), held.end(), slice.offset);
+			if (found == held.end())
+				return;
+
+			held.erase(found);
+			openSlices++;
+		}
+
+		// Fence for the submit reading everything allocated since the last one, the space comes back once it signals
+
+		VkFence close()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			if (freeFences.empty())
+			{
+				VkFenceCreateInfo createInfo = {};
+				createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+				VkFence fence;
+				if (vkCreateFence(device, &createInfo, nullptr, &fence) != VK_SUCCESS)
+					throw err::err("cannot create a staging fence");
+				freeFences.push_back(fence);
+			}
+
+			open.fence = freeFences.back();
+			freeFences.pop_back();
+			vkResetFences(device, 1, &open.fence);
+
+			open.end = held.empty() ? head : held.front();
+			batches.push_back(std::move(open));
+
+			open = {};
+			openSlices = 0u;
+
+			return batches.back().fence;
+		}
+
+		void destroy()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			for (auto& batch : batches)
+			{
+				vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+				retire(batch);
+			}
+			batches.clear();
+
+			// Staged but never submitted
+
+			for (auto& [oversizedBuffer, oversizedMemory] : open.oversized)
+			{
+				vkDestroyBuffer(device, oversizedBuffer, nullptr);
+				deviceAllocator.free(oversizedMemory);
+			}
+
+			for (auto& [oversizedBuffer, oversizedMemory] : heldOversized)
+			{
+				vkDestroyBuffer(device, oversizedBuffer, nullptr);
+				deviceAllocator.free(oversizedMemory);
+			}
+
+			open = {};
+			openSlices = 0u;
+			held.clear();
+			heldOversized.clear();
+
+			for (const auto fence : freeFences)
+				vkDestroyFence(device, fence, nullptr);
+			freeFences.clear();
+
+			vkDestroyBuffer(device, buffer, nullptr);
+			deviceAllocator.free(memory);
+
+			buffer = VK_NULL_HANDLE;
+			device = VK_NULL_HANDLE;
+		}
+	};
+
+	static StagingRing stagingRing;
+
+	namespace memory
+	{
+		// Releases held slices when whatever's filling them throws partway, dismiss it once they're handed over. A held slice that's
+		// never released pins the ring for good
+
+		class HeldSlices
+		{
+			std::vector<StagingSlice>& slices;
+			bool dismissed{ false };
+
+		public:
+			explicit HeldSlices(std::vector<StagingSlice>& held) : slices{ held } {}
+			HeldSlices(const HeldSlices&) = delete;
+
+			~HeldSlices()
+			{
+				if (!dismissed)
+					for (const auto& slice : slices)
+						stagingRing.release(slice);
+			}
+
+			void dismiss()
+			{
+				dismissed = true;
+			}
+		};
+	}
+}
\ No newline at end of file
@@ -0,0 +1,605 @@
+/*
+*	Desc: Transfer queue
+*	Note: Uploads are recorded into one command buffer & submitted without waiting, a timeline semaphore tells when they're done
+*/
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../../utilities/console/err.hpp"
+#include "staging.hpp"
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// Command buffers of one submit, reused once the timeline passes its value
+
+		struct TransferBatch
+		{
+			std::uint64_t value{ 0u };
+			VkCommandBuffer transfer{ VK_NULL_HANDLE };
+			VkCommandBuffer acquire{ VK_NULL_HANDLE };
+		};
+
+		// One image's pixels, already written to staging. Levels past the ones given get blitted down from the last one given
+
+		struct ImageUpload
+		{
+			std::vector<StagingSlice> levels;
+			VkImage image{ VK_NULL_HANDLE };
+			std::uint32_t width{ 0u };
+			std::uint32_t height{ 0u };
+			std::uint32_t mipLevels{ 1u };
+		};
+
+		// Levels firstGenerated & up still to blit, everything's in TRANSFER_DST until then
+
+		struct MipChain
+		{
+			VkImage image{ VK_NULL_HANDLE };
+			std::uint32_t width{ 0u };
+			std::uint32_t height{ 0u };
+			std::uint32_t firstGenerated{ 1u };
+			std::uint32_t mipLevels{ 1u };
+
+			VkImageLayout finalLayout{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			VkPipelineStageFlags dstStage{ 0u };
+			VkAccessFlags dstAccess{ 0u };
+		};
+	}
+
+	// With a dedicated transfer family every resource goes through a queue family ownership transfer: released on the transfer queue,
+	// acquired on the graphics queue by a small submit that waits on the copies. Frames submitted after that are ordered behind it, so nothing
+	// on the CPU ever waits on an upload. Submits happen on the render thread (the graphics queue isn't ours alone)
+
+	class TransferQueue
+	{
+		VkDevice device{ VK_NULL_HANDLE };
+
+		VkQueue queue{ VK_NULL_HANDLE };
+		std::uint32_t family{ 0u };
+		VkCommandPool pool{ VK_NULL_HANDLE };
+
+		VkQueue graphicsQueue{ VK_NULL_HANDLE };
+		std::uint32_t graphicsFamily{ 0u };
+		VkCommandPool graphicsPool{ VK_NULL_HANDLE };
+
+		VkSemaphore timeline{ VK_NULL_HANDLE };
+		std::uint64_t lastValue{ 0u };
+
+		VkCommandBuffer recording{ VK_NULL_HANDLE };
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		std::vector<memory::MipChain> acquireMips; // Blits need a graphics queue, with a dedicated transfer family they go right after the acquire
+		VkPipelineStageFlags acquireStages{ 0u };
+
+		std::deque<memory::TransferBatch> batches;
+		std::vector<VkCommandBuffer> freeTransfer;
+		std::vector<VkCommandBuffer> freeAcquire;
+
+		std::mutex lock;
+
+		VkCommandBuffer takeCommandBuffer(std::vector<VkCommandBuffer>& free, VkCommandPool commandPool)
+		{
+			VkCommandBuffer commandBuffer;
+
+			if (!free.empty())
+			{
+				commandBuffer = free.back();
+				free.pop_back();
+				vkResetCommandBuffer(commandBuffer, 0);
+			}
+			else
+			{
+				VkCommandBufferAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.commandPool = commandPool;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandBufferCount = 1;
+
+				if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+					throw err::err("can't allocate a transfer command buffer");
+			}
+
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+			return commandBuffer;
+		}
+
+		VkCommandBuffer current()
+		{
+			if (recording == VK_NULL_HANDLE)
+				recording = takeCommandBuffer(freeTransfer, pool);
+			return recording;
+		}
+
+		void recycle()
+		{
+			std::uint64_t completed{ 0u };
+			vkGetSemaphoreCounterValue(device, timeline, &completed);
+
+			while (!batches.empty() && batches.front().value <= completed)
+			{
+				freeTransfer.push_back(batches.front().transfer);
+				if (batches.front().acquire != VK_NULL_HANDLE)
+					freeAcquire.push_back(batches.front().acquire);
+				batches.pop_front();
+			}
+		}
+
+		static auto imageBarrier(VkImage image, std::uint32_t baseLevel, std::uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+		{
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = baseLevel;
+			barrier.subresourceRange.levelCount = levelCount;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			return barrier;
+		}
+
+		// Level by level across every chain, so a batch costs two barriers per level rather than per image & level
+
+		static void recordMips(VkCommandBuffer commandBuffer, const std::vector<memory::MipChain>& chains)
+		{
+			if (chains.empty())
+				return;
+
+			std::uint32_t deepest{ 0u };
+			VkPipelineStageFlags dstStages{ 0u };
+
+			for (const auto& chain : chains)
+			{
+				deepest = std::max(deepest, chain.mipLevels);
+				dstStages |= chain.dstStage;
+			}
+
+			std::vector<VkImageMemoryBarrier> barriers;
+			std::vector<const memory::MipChain*> blitting;
+
+			for (auto level = 1u; level < deepest; level++)
+			{
+				barriers.clear();
+				blitting.clear();
+
+				for (const auto& chain : chains)
+				{
+					if (level < chain.firstGenerated || level >= chain.mipLevels)
+						continue;
+
+					blitting.push_back(&chain);
+					barriers.push_back(imageBarrier(chain.image, level - 1u, 1u, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+				}
+
+				if (blitting.empty())
+					continue;
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+					static_cast<std::uint32_t>(barriers.size()), barriers.data());
+
+				for (const auto chain : blitting)
+				{
+					VkImageBlit blit{};
+					blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					blit.srcSubresource.mipLevel = level - 1u;
+					blit.srcSubresource.baseArrayLayer = 0;
+					blit.srcSubresource.layerCount = 1;
+					blit.srcOffsets[1] = { static_cast<std::int32_t>(std::max(chain->width >> (level - 1u), 1u)), static_cast<std::int32_t>(std::max(chain->height >> (level - 1u), 1u)), 1 };
+
+					blit.dstSubresource = blit.srcSubresource;
+					blit.dstSubresource.mipLevel = level;
+					blit.dstOffsets[1] = { static_cast<std::int32_t>(std::max(chain->width >> level, 1u)), static_cast<std::int32_t>(std::max(chain->height >> level, 1u)), 1 };
+
+					vkCmdBlitImage(commandBuffer, chain->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+				}
+
+				// Sources are done, off to wherever they're read from
+
+				for (auto i = 0u; i < barriers.size(); i++)
+				{
+					barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					barriers[i].newLayout = blitting[i]->finalLayout;
+					barriers[i].srcAccessMask = 0;
+					barriers[i].dstAccessMask = blitting[i]->dstAccess;
+				}
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 0, nullptr, 0, nullptr,
+					static_cast<std::uint32_t>(barriers.size()), barriers.data());
+			}
+
+			// Left in TRANSFER_DST: the last level & any given below the first one blitted from
+
+			barriers.clear();
+
+			for (const auto& chain : chains)
+			{
+				if (chain.firstGenerated > 1u)
+					barriers.push_back(imageBarrier(chain.image, 0u, chain.firstGenerated - 1u, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, chain.finalLayout,
+						VK_ACCESS_TRANSFER_WRITE_BIT, chain.dstAccess));
+
+				barriers.push_back(imageBarrier(chain.image, chain.mipLevels - 1u, 1u, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, chain.finalLayout,
+					VK_ACCESS_TRANSFER_WRITE_BIT, chain.dstAccess));
+			}
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 0, nullptr, 0, nullptr,
+				static_cast<std::uint32_t>(barriers.size()), barriers.data());
+		}
+
+		static auto createPool(VkDevice device, std::uint32_t queueIndex)
+		{
+			VkCommandPoolCreateInfo poolCreateInfo = {};
+			poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolCreateInfo.queueFamilyIndex = queueIndex;
+
+			VkCommandPool commandPool;
+			if (vkCreateCommandPool(device, &poolCreateInfo, nullptr, &commandPool) != VK_SUCCESS)
+				throw err::err("cannot create transfer command pool");
+
+			return commandPool;
+		}
+
+	public:
+		void init(VkDevice logicalDevice, std::uint32_t transferFamily, VkQueue transferQueue, std::uint32_t graphicsQueueFamily, VkQueue graphicsQueueHandle)
+		{
+			device = logicalDevice;
+
+			family = transferFamily;
+			queue = transferQueue;
+			graphicsFamily = graphicsQueueFamily;
+			graphicsQueue = graphicsQueueHandle;
+
+			pool = createPool(device, family);
+			if (dedicated())
+				graphicsPool = createPool(device, graphicsFamily);
+
+			VkSemaphoreTypeCreateInfo typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			typeInfo.initialValue = 0u;
+
+			VkSemaphoreCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			createInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(device, &createInfo, nullptr, &timeline) != VK_SUCCESS)
+				throw err::err("cannot create the transfer timeline semaphore");
+
+			lastValue = 0u;
+		}
+
+		bool dedicated()
+		{
+			return family != graphicsFamily;
+		}
+
+		// Buffer ends up readable at dstStage with dstAccess on the graphics queue
+
+		void copyBuffer(const memory::StagingSlice& source, VkBuffer destination, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			const auto commandBuffer = current();
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.srcOffset = source.offset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(commandBuffer, source.buffer, destination, 1, &copyRegion);
+
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = destination;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+
+			if (!dedicated())
+			{
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+				return;
+			}
+
+			// Release (the access on the releasing side is ignored), the acquire half goes in the graphics submit
+
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = family;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = dstAccess;
+			bufferAcquires.push_back(barrier);
+			acquireStages |= dstStage;
+		}
+
+		// Whole images from undefined, through the copies (& blits), into finalLayout on the graphics queue. A batch costs three barriers total
+		// instead of three each (plus two per blitted level), nothing is waited on between them
+
+		void copyImages(const std::vector<memory::ImageUpload>& uploads, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT)
+		{
+			if (uploads.empty())
+				return;
+
+			std::lock_guard<std::mutex> guard(lock);
+
+			const auto commandBuffer = current();
+
+			std::vector<VkImageMemoryBarrier> barriers;
+			barriers.reserve(uploads.size());
+
+			for (const auto& upload : uploads)
+				barriers.push_back(imageBarrier(upload.image, 0u, upload.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+				static_cast<std::uint32_t>(barriers.size()), barriers.data());
+
+			for (const auto& upload : uploads)
+			{
+				for (auto level = 0u; level < upload.levels.size() && level < upload.mipLevels; level++)
+				{
+					VkBufferImageCopy region{};
+					region.bufferOffset = upload.levels[level].offset;
+					region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.baseArrayLayer = 0;
+					region.imageSubresource.layerCount = 1;
+					region.imageOffset = { 0, 0, 0 };
+					region.imageExtent = { std::max(upload.width >> level, 1u), std::max(upload.height >> level, 1u), 1 };
+
+					vkCmdCopyBufferToImage(commandBuffer, upload.levels[level].buffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+				}
+			}
+
+			// Images missing levels stay in TRANSFER_DST for the blits, the rest go straight to finalLayout. Both halves of an ownership transfer
+			// carry the same layout change
+
+			std::vector<VkImageMemoryBarrier> finished;
+			std::vector<VkImageMemoryBarrier> unfinished;
+			std::vector<memory::MipChain> chains;
+
+			for (auto i = 0u; i < uploads.size(); i++)
+			{
+				const auto& upload = uploads[i];
+
+				if (upload.levels.size() >= upload.mipLevels)
+				{
+					auto barrier = barriers[i];
+					barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					barrier.newLayout = finalLayout;
+					barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barrier.dstAccessMask = dstAccess;
+					finished.push_back(barrier);
+					continue;
+				}
+
+				memory::MipChain chain;
+				chain.image = upload.image;
+				chain.width = upload.width;
+				chain.height = upload.height;
+				chain.firstGenerated = std::max(static_cast<std::uint32_t>(upload.levels.size()), 1u);
+				chain.mipLevels = upload.mipLevels;
+				chain.finalLayout = finalLayout;
+				chain.dstStage = dstStage;
+				chain.dstAccess = dstAccess;
+				chains.push_back(chain);
+
+				auto barrier = barriers[i];
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+				unfinished.push_back(barrier);
+			}
+
+			// Without a dedicated family this is the graphics queue already, so the blits go right here
+
+			if (!dedicated())
+			{
+				if (!finished.empty())
+					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr,
+						static_cast<std::uint32_t>(finished.size()), finished.data());
+
+				recordMips(commandBuffer, chains);
+				return;
+			}
+
+			std::vector<VkImageMemoryBarrier> releases;
+			releases.reserve(uploads.size());
+
+			for (auto& barrier : finished)
+			{
+				barrier.srcQueueFamilyIndex = family;
+				barrier.dstQueueFamilyIndex = graphicsFamily;
+				releases.push_back(barrier);
+				releases.back().dstAccessMask = 0;
+
+				barrier.srcAccessMask = 0;
+				imageAcquires.push_back(barrier);
+			}
+
+			for (auto& barrier : unfinished)
+			{
+				barrier.srcQueueFamilyIndex = family;
+				barrier.dstQueueFamilyIndex = graphicsFamily;
+				releases.push_back(barrier);
+				releases.back().dstAccessMask = 0;
+
+				barrier.srcAccessMask = 0;
+				imageAcquires.push_back(barrier);
+			}
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+				static_cast<std::uint32_t>(releases.size()), releases.data());
+
+			if (!finished.empty())
+				acquireStages |= dstStage;
+
+			if (!chains.empty())
+			{
+				acquireStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+				acquireMips.insert(acquireMips.end(), chains.begin(), chains.end());
+			}
+		}
+
+		void copyImage(const memory::StagingSlice& source, VkImage image, std::uint32_t width, std::uint32_t height, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT)
+		{
+			copyImages({ memory::ImageUpload{ { source }, image, width, height, 1u } }, finalLayout, dstStage, dstAccess);
+		}
+
+		// Sends off everything recorded so far, the value it returns is reached once it's all usable on the graphics queue
+
+		std::uint64_t submit()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			recycle();
+
+			if (recording == VK_NULL_HANDLE)
+				return lastValue;
+
+			memory::TransferBatch batch;
+			batch.transfer = recording;
+			recording = VK_NULL_HANDLE;
+
+			vkEndCommandBuffer(batch.transfer);
+
+			const auto copiedValue = ++lastValue;
+
+			VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &copiedValue;
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &batch.transfer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+
+			// The staging ring gets its space back with this fence
+
+			if (vkQueueSubmit(queue, 1, &submitInfo, stagingRing.close()) != VK_SUCCESS)
+				throw err::err("could not submit uploads");
+
+			if (dedicated())
+			{
+				batch.acquire = takeCommandBuffer(freeAcquire, graphicsPool);
+
+				vkCmdPipelineBarrier(batch.acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquireStages ? acquireStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT), 0, 0, nullptr,
+					static_cast<std::uint32_t>(bufferAcquires.size()), bufferAcquires.data(), static_cast<std::uint32_t>(imageAcquires.size()), imageAcquires.data());
+				recordMips(batch.acquire, acquireMips);
+				vkEndCommandBuffer(batch.acquire);
+
+				bufferAcquires.clear();
+				imageAcquires.clear();
+				acquireMips.clear();
+				acquireStages = 0u;
+
+				const auto acquiredValue = ++lastValue;
+
+				VkTimelineSemaphoreSubmitInfo acquireTimelineInfo = {};
+				acquireTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+				acquireTimelineInfo.waitSemaphoreValueCount = 1;
+				acquireTimelineInfo.pWaitSemaphoreValues = &copiedValue;
+				acquireTimelineInfo.signalSemaphoreValueCount = 1;
+				acquireTimelineInfo.pSignalSemaphoreValues = &acquiredValue;
+
+				const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+				VkSubmitInfo acquireInfo = {};
+				acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+				acquireInfo.pNext = &acquireTimelineInfo;
+				acquireInfo.waitSemaphoreCount = 1;
+				acquireInfo.pWaitSemaphores = &timeline;
+				acquireInfo.pWaitDstStageMask = &waitStage;
+				acquireInfo.commandBufferCount = 1;
+				acquireInfo.pCommandBuffers = &batch.acquire;
+				acquireInfo.signalSemaphoreCount = 1;
+				acquireInfo.pSignalSemaphores = &timeline;
+
+				if (vkQueueSubmit(graphicsQueue, 1, &acquireInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+					throw err::err("could not submit upload ownership acquires");
+			}
+
+			batch.value = lastValue;
+			batches.push_back(batch);
+
+			return lastValue;
+		}
+
+		bool complete(std::uint64_t value)
+		{
+			std::uint64_t completed{ 0u };
+			vkGetSemaphoreCounterValue(device, timeline, &completed);
+			return completed >= value;
+		}
+
+		void wait(std::uint64_t value)
+		{
+			VkSemaphoreWaitInfo waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &value;
+
+			vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+		}
+
+		void destroy()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			if (recording != VK_NULL_HANDLE)
+				vkEndCommandBuffer(recording);
+			recording = VK_NULL_HANDLE;
+
+			bufferAcquires.clear();
+			imageAcquires.clear();
+			acquireMips.clear();
+			acquireStages = 0u;
+
+			// Pools take their command buffers with them
+
+			batches.clear();
+			freeTransfer.clear();
+			freeAcquire.clear();
+
+			vkDestroySemaphore(device, timeline, nullptr);
+			vkDestroyCommandPool(device, pool, nullptr);
+			if (graphicsPool != VK_NULL_HANDLE)
+				vkDestroyCommandPool(device, graphicsPool, nullptr);
+
+			graphicsPool = VK_NULL_HANDLE;
+			device = VK_NULL_HANDLE;
+		}
+	};
+
+	static TransferQueue transferQueue;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+/*
+*	Desc: Pipeline cache
+*	Note: Every pipeline is built through one VkPipelineCache that's saved to disk on shutdown & loaded back on startup, so the driver only compiles shaders once per device & driver
+*/
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../utilities/utilFlags.hpp"
+#include "../../../../utilities/console/err.hpp"
+#include "../../../../utilities/console/logger.hpp"
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// Ours, in front of the driver's data. A different GPU or driver (or a file cut short) makes the whole thing cold
+
+		struct PipelineCacheHeader
+		{
+			char magic[4]{ 'Z', 'K', 'P', 'C' };
+			std::uint32_t version{ 1u };
+
+			std::uint32_t vendorID{ 0u };
+			std::uint32_t deviceID{ 0u };
+			std::uint32_t driverVersion{ 0u };
+			std::uint8_t deviceUUID[VK_UUID_SIZE]{};
+			std::uint8_t cacheUUID[VK_UUID_SIZE]{};
+
+			std::uint64_t dataSize{ 0u };
+			std::uint64_t checksum{ 0u };
+		};
+	}
+
+	class PipelineCache
+	{
+		VkDevice device{ VK_NULL_HANDLE };
+		VkPipelineCache cache{ VK_NULL_HANDLE };
+		std::filesystem::path path;
+
+		memory::PipelineCacheHeader expected; // What this device writes, anything loaded has to match it
+		std::size_t loadedBytes{ 0u };
+
+		static constexpr std::uint64_t maxDataSize{ 256ull * 1024u * 1024u }; // Way past what drivers write for us, anything bigger is garbage
+
+		static std::uint64_t checksum(const std::uint8_t* data, std::size_t size)
+		{
+			auto hash{ 0xCBF29CE484222325ull };
+			for (std::size_t i = 0u; i < size; i++)
+				hash = (hash ^ data[i]) * 0x100000001B3ull;
+			return hash;
+		}
+
+		// The file's data when it was written for this exact device & driver, empty otherwise
+
+		std::vector<std::uint8_t> read(std::string& reason) const
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+			{
+				reason = "no cache file";
+				return {};
+			}
+
+			memory::PipelineCacheHeader header;
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			{
+				reason = "header cut short";
+				return {};
+			}
+
+			if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) || header.version != expected.version)
+			{
+				reason = "not a pipeline cache";
+				return {};
+			}
+
+			if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID || std::memcmp(header.deviceUUID, expected.deviceUUID, VK_UUID_SIZE))
+			{
+				reason = "written for another device";
+				return {};
+			}
+
+			if (header.driverVersion != expected.driverVersion || std::memcmp(header.cacheUUID, expected.cacheUUID, VK_UUID_SIZE))
+			{
+				reason = "written by another driver";
+				return {};
+			}
+
+			// The size is only trusted once it matches what's left of the file, a corrupt one would otherwise ask for any amount of memory
+
+			std::error_code error;
+			const auto fileSize = std::filesystem::file_size(path, error);
+
+			if (error || fileSize < sizeof(header) || header.dataSize != fileSize - sizeof(header) || header.dataSize > maxDataSize)
+			{
+				reason = "size doesn't match the file";
+				return {};
+			}
+
+			std::vector<std::uint8_t> data(static_cast<std::size_t>(header.dataSize));
+			if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())) || checksum(data.data(), data.size()) != header.checksum)
+			{
+				reason = "data cut short or corrupt";
+				return {};
+			}
+
+			// The driver's own header, some drivers don't take a mismatch here gracefully
+
+			VkPipelineCacheHeaderVersionOne driverHeader;
+			if (data.size() < sizeof(driverHeader))
+			{
+				reason = "empty cache";
+				return {};
+			}
+
+			std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+			if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || driverHeader.vendorID != expected.vendorID || driverHeader.deviceID != expected.deviceID ||
+				std::memcmp(driverHeader.pipelineCacheUUID, expected.cacheUUID, VK_UUID_SIZE))
+			{
+				reason = "driver data doesn't match";
+				return {};
+			}
+
+			return data;
+		}
+
+		void create(const std::vector<std::uint8_t>& data)
+		{
+			VkPipelineCacheCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			createInfo.initialDataSize = data.size();
+			createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+			if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS)
+				throw err::err("failed to create the pipeline cache");
+
+			loadedBytes = data.size();
+		}
+
+	public:
+		void init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, const std::filesystem::path& file)
+		{
+			device = logicalDevice;
+			path = file;
+
+			VkPhysicalDeviceIDProperties idProperties = {};
+			idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &idProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+			expected = {};
+			expected.vendorID = properties.properties.vendorID;
+			expected.deviceID = properties.properties.deviceID;
+			expected.driverVersion = properties.properties.driverVersion;
+			std::memcpy(expected.deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+			std::memcpy(expected.cacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+			std::string reason;
+			const auto data = read(reason);
+
+			if (data.empty())
+				logger.log("pipeline cache | starting cold (%s)\n", reason.c_str());
+			else
+				logger.log("pipeline cache | loaded %zu bytes from %s\n", data.size(), path.string().c_str());
+
+			create(data);
+		}
+
+		VkPipelineCache get() const
+		{
+			return cache;
+		}
+
+		// Bytes it started out with, 0 when cold
+
+		std::size_t loaded() const
+		{
+			return loadedBytes;
+		}
+
+		// Throws away what's in memory & starts cold, the file stays as it is
+
+		void reset()
+		{
+			vkDestroyPipelineCache(device, cache, nullptr);
+			create({});
+		}
+
+		// Written next to the file & renamed over it, a crash halfway never leaves a broken cache behind
+
+		void save()
+		{
+			std::size_t size{ 0u };
+			if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || !size)
+				return;
+
+			std::vector<std::uint8_t> data(size);
+			if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+				return;
+			data.resize(size);
+
+			auto header = expected;
+			header.dataSize = data.size();
+			header.checksum = checksum(data.data(), data.size());
+
+			auto temporary = path;
+			temporary += ".tmp";
+
+			{
+				std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+				if (!file)
+				{
+					logger.log("pipeline cache | couldn't write %s\n", temporary.string().c_str());
+					return;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporary, path, error);
+			if (error)
+				logger.log("pipeline cache | couldn't replace %s (%s)\n", path.string().c_str(), error.message().c_str());
+		}
+
+		// Saves, then lets go of the cache (before the device goes)
+
+		void destroy()
+		{
+			if (cache == VK_NULL_HANDLE)
+				return;
+
+			save();
+			vkDestroyPipelineCache(device, cache, nullptr);
+
+			cache = VK_NULL_HANDLE;
+			device = VK_NULL_HANDLE;
+		}
+	};
+
+	static PipelineCache pipelineCache;
+}
\ No newline at end of file
@@ -0,0 +1,381 @@
+/*
+*	Desc: Texture cache
+*	Note: Textures are found by path, size & write time on the render thread. The workers hash what they load, so the same image under any path ends up
+*	as one GPU copy shared through refcounted handles
+*/
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <filesystem>
+#include <unordered_map>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../utilities/files/fs.hpp"
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// One texture on the GPU & who's using it, unreferenced ones wait in the LRU until the budget wants their memory back
+
+		struct CachedTexture
+		{
+			std::uint32_t slot{ 0u };
+			std::uint32_t references{ 0u };
+			VkDeviceSize bytes{ 0u };
+			bool resident{ false }; // Uploaded, a pending load can't be evicted
+			bool failed{ false }; // The load failed, the slot only has the placeholder
+
+			std::uint64_t content{ 0u }; // Hash of what got loaded, 0 until it's published
+
+			std::list<std::uint64_t>::iterator unused;
+		};
+	}
+
+	class TextureCache;
+
+	// Keeps a cached texture alive, copies share it & the last one gone makes it evictable
+
+	class TextureHandle
+	{
+		TextureCache* cache{ nullptr };
+		std::uint64_t hash{ 0u };
+		std::uint32_t index{ 0u };
+
+	public:
+		TextureHandle() = default;
+		TextureHandle(TextureCache* owner, std::uint64_t key, std::uint32_t slot);
+		TextureHandle(const TextureHandle& other);
+		TextureHandle(TextureHandle&& other) noexcept;
+		TextureHandle& operator=(TextureHandle other) noexcept;
+		~TextureHandle();
+
+		// Where it sits in the engine's textures, a duplicate that got folded moves to the slot of the copy it was folded into
+
+		std::uint32_t slot() const;
+
+		bool valid() const
+		{
+			return cache != nullptr;
+		}
+	};
+
+	class TextureCache
+	{
+		std::unordered_map<std::uint64_t, memory::CachedTexture> entries;
+		std::unordered_map<std::uint32_t, std::uint64_t> slots; // What's in each engine slot
+		std::unordered_map<std::uint64_t, std::uint64_t> contents; // Content hash to the entry holding it
+		std::unordered_map<std::uint64_t, std::uint64_t> aliases; // Entries folded into another with the same contents
+
+		std::list<std::uint64_t> unused; // Unreferenced entries, least recently used first
+		VkDeviceSize residentBytes{ 0u };
+
+		static std::uint64_t hashBytes(const std::uint8_t* data, std::size_t size, std::uint64_t hash = 0xCBF29CE484222325ull)
+		{
+			for (std::size_t i = 0u; i < size; i++)
+				hash = (hash ^ data[i]) * 0x100000001B3ull;
+			return hash;
+		}
+
+		// The file a load of path reads, the .ktx2 next to it when there is one
+
+		static std::filesystem::path source(const std::string& path)
+		{
+			std::filesystem::path file(path);
+
+			if (file.extension() != ".ktx2")
+			{
+				auto compressed = file;
+				compressed.replace_extension(".ktx2");
+
+				std::error_code error;
+				if (std::filesystem::exists(compressed, error))
+					file = compressed;
+			}
+
+			return file;
+		}
+
+		std::uint64_t resolve(std::uint64_t key) const
+		{
+			const auto found = aliases.find(key);
+			return found != aliases.end() ? found->second : key;
+		}
+
+	public:
+		// Render thread key, only stats the file. Changing it gives a new key & the old copy ages out through the LRU
+
+		static std::uint64_t key(const std::string& path)
+		{
+			const auto file = source(path);
+
+			std::error_code error;
+			const auto name = std::filesystem::weakly_canonical(file, error).string();
+			const auto size = static_cast<std::uint64_t>(std::filesystem::file_size(file, error));
+			const auto written = static_cast<std::uint64_t>(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+
+			auto hash = hashBytes(reinterpret_cast<const std::uint8_t*>(name.data()), name.size());
+			hash = hashBytes(reinterpret_cast<const std::uint8_t*>(&size), sizeof(size), hash);
+			return hashBytes(reinterpret_cast<const std::uint8_t*>(&written), sizeof(written), hash);
+		}
+
+		// FNV-1a over what a load of path reads, it maps the whole file so it's for the workers. A file we can't read gets 0 (never folded)
+
+		static std::uint64_t contentHash(const std::string& path)
+		{
+			const fs::MappedFile file(source(path));
+			if (file.data() == nullptr)
+				return 0u;
+
+			return hashBytes(file.data(), file.size());
+		}
+
+		// A handle on what's already cached for hash, nothing when it has to be loaded
+
+		std::optional<TextureHandle> find(std::uint64_t hash)
+		{
+			const auto found = entries.find(resolve(hash));
+			if (found == entries.end())
+				return {};
+
+			return TextureHandle(this, hash, found->second.slot);
+		}
+
+		// Where hash's texture sits now, fallback once it's gone
+
+		std::uint32_t slot(std::uint64_t hash, std::uint32_t fallback) const
+		{
+			const auto found = entries.find(resolve(hash));
+			return found != entries.end() ? found->second.slot : fallback;
+		}
+
+		// The load into slot finished with content. When another entry already holds the same contents this one's folded into it (its
+		// handles and anyone asking for its key get that copy) & true says the load & the slot can go, otherwise it's the copy from now on
+
+		bool fold(std::uint32_t slot, std::uint64_t content)
+		{
+			const auto found = slots.find(slot);
+			if (found == slots.end() || !content)
+				return false;
+
+			const auto loaded = found->second;
+			const auto existing = contents.find(content);
+
+			if (existing == contents.end() || existing->second == loaded || !entries.contains(existing->second))
+			{
+				entries[loaded].content = content;
+				contents[content] = loaded;
+				return false;
+			}
+
+			auto& duplicate = entries[loaded];
+			auto& target = entries[existing->second];
+
+			if (duplicate.unused != unused.end())
+				unused.erase(duplicate.unused);
+
+			if (duplicate.references && target.unused != unused.end())
+			{
+				unused.erase(target.unused);
+				target.unused = unused.end();
+			}
+
+			target.references += duplicate.references;
+			aliases[loaded] = existing->second;
+
+			slots.erase(found);
+			entries.erase(loaded);
+			return true;
+		}
+
+		// A texture about to be loaded into slot, the handle keeps it from being evicted
+
+		TextureHandle insert(std::uint64_t hash, std::uint32_t slot)
+		{
+			memory::CachedTexture entry;
+			entry.slot = slot;
+			entry.unused = unused.end();
+
+			entries[hash] = entry;
+			slots[slot] = hash;
+			return TextureHandle(this, hash, slot);
+		}
+
+		// The load into slot failed, it keeps the placeholder while it's held & goes once it isn't
+
+		void fail(std::uint32_t slot)
+		{
+			const auto found = slots.find(slot);
+			if (found != slots.end())
+				entries[found->second].failed = true;
+		}
+
+		// A failed entry asked for again gets another load into its slot, true when the caller should request it
+
+		bool reload(std::uint64_t hash)
+		{
+			const auto found = entries.find(resolve(hash));
+			if (found == entries.end() || !found->second.failed)
+				return false;
+
+			found->second.failed = false;
+			return true;
+		}
+
+		// Failed loads nobody holds anymore, their slots are free again (there's nothing to destroy, they only had the placeholder)
+
+		std::vector<std::uint32_t> dropFailed()
+		{
+			std::vector<std::uint32_t> dropped;
+
+			for (auto candidate = unused.begin(); candidate != unused.end();)
+			{
+				auto& entry = entries[*candidate];
+				if (!entry.failed)
+				{
+					candidate++;
+					continue;
+				}
+
+				dropped.push_back(entry.slot);
+
+				slots.erase(entry.slot);
+				std::erase_if(aliases, [&](const auto& alias) { return alias.second == *candidate; });
+				entries.erase(*candidate);
+				candidate = unused.erase(candidate);
+			}
+
+			return dropped;
+		}
+
+		// The texture in slot got uploaded, it counts against the budget from now on
+
+		void resident(std::uint32_t slot, VkDeviceSize bytes)
+		{
+			const auto found = slots.find(slot);
+			if (found == slots.end())
+				return;
+
+			auto& entry = entries[found->second];
+			if (entry.resident)
+				return;
+
+			entry.resident = true;
+			entry.bytes = bytes;
+			residentBytes += bytes;
+		}
+
+		void acquire(std::uint64_t hash)
+		{
+			const auto found = entries.find(resolve(hash));
+			if (found == entries.end())
+				return;
+
+			auto& entry = found->second;
+			if (entry.unused != unused.end())
+			{
+				unused.erase(entry.unused);
+				entry.unused = unused.end();
+			}
+
+			entry.references++;
+		}
+
+		void release(std::uint64_t hash)
+		{
+			const auto found = entries.find(resolve(hash));
+			if (found == entries.end() || !found->second.references)
+				return;
+
+			auto& entry = found->second;
+			if (!--entry.references)
+				entry.unused = unused.insert(unused.end(), found->first);
+		}
+
+		// Drops unreferenced textures, oldest first, until what's uploaded fits in budget. Returns the slots to free, their
+		// textures may still be in use by frames in flight
+
+		std::vector<std::uint32_t> trim(VkDeviceSize budget)
+		{
+			std::vector<std::uint32_t> evicted;
+
+			for (auto candidate = unused.begin(); candidate != unused.end() && residentBytes > budget;)
+			{
+				auto& entry = entries[*candidate];
+				if (!entry.resident)
+				{
+					candidate++;
+					continue;
+				}
+
+				residentBytes -= entry.bytes;
+				evicted.push_back(entry.slot);
+
+				slots.erase(entry.slot);
+				contents.erase(entry.content);
+				std::erase_if(aliases, [&](const auto& alias) { return alias.second == *candidate; });
+				entries.erase(*candidate);
+				candidate = unused.erase(candidate);
+			}
+
+			return evicted;
+		}
+
+		VkDeviceSize usage() const
+		{
+			return residentBytes;
+		}
+
+		// Forgets everything, the engine destroys the textures themselves. Handles still around turn into no-ops
+
+		void destroy()
+		{
+			entries.clear();
+			slots.clear();
+			contents.clear();
+			aliases.clear();
+			unused.clear();
+			residentBytes = 0u;
+		}
+	};
+
+	inline TextureHandle::TextureHandle(TextureCache* owner, std::uint64_t key, std::uint32_t slot) : cache{ owner }, hash{ key }, index{ slot }
+	{
+		cache->acquire(hash);
+	}
+
+	inline TextureHandle::TextureHandle(const TextureHandle& other) : cache{ other.cache }, hash{ other.hash }, index{ other.index }
+	{
+		if (cache != nullptr)
+			cache->acquire(hash);
+	}
+
+	inline TextureHandle::TextureHandle(TextureHandle&& other) noexcept : cache{ std::exchange(other.cache, nullptr) }, hash{ other.hash }, index{ other.index }
+	{
+	}
+
+	inline TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept
+	{
+		std::swap(cache, other.cache);
+		std::swap(hash, other.hash);
+		std::swap(index, other.index);
+		return *this;
+	}
+
+	inline std::uint32_t TextureHandle::slot() const
+	{
+		return cache != nullptr ? cache->slot(hash, index) : index;
+	}
+
+	inline TextureHandle::~TextureHandle()
+	{
+		if (cache != nullptr)
+			cache->release(hash);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+/*
+*	Desc: Texture loader
+*	Note: Images decode (or KTX2s get copied out) on the workers straight into staging, the render thread picks up whatever's done & uploads it in one submit
+*/
+#pragma once
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <cstdint>
+#include <exception>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "../../../../utilities/console/err.hpp"
+#include "../../../../utilities/console/logger.hpp"
+#include "../../../scheduler/workers.hpp"
+#include "memory/ktx2.hpp"
+#include "texture-cache.hpp"
+
+namespace vulkan
+{
+	namespace memory
+	{
+		// A decode that finished, image is empty when it failed (the texture keeps its placeholder then)
+
+		struct LoadedTexture
+		{
+			std::uint32_t index{ 0u };
+			std::uint64_t content{ 0u }; // What the file hashed to, publishing folds duplicates by it
+			std::optional<DecodedImage> image;
+		};
+	}
+
+	class TextureLoader
+	{
+		zkelp::worker_pool_t* workers{ nullptr };
+		zkelp::scheduler_types::job_group_t group;
+
+		VkPhysicalDevice physicalDevice{ VK_NULL_HANDLE };
+		bool cpuMips{ false }; // The GPU can't blit our format, mips get made while decoding
+
+		std::mutex lock;
+		std::vector<memory::LoadedTexture> finished;
+
+	public:
+		void init(VkPhysicalDevice device, bool makeCpuMips)
+		{
+			physicalDevice = device;
+			cpuMips = makeCpuMips;
+		}
+
+		// Decodes on the workers (right here when there aren't any), index is where it'll go in the engine's textures
+
+		void request(zkelp::worker_pool_t* pool, std::uint32_t index, std::string path)
+		{
+			auto job = [this, index, path = std::move(path)]() {
+				memory::LoadedTexture loaded;
+				loaded.index = index;
+
+				try
+				{
+					loaded.image = loadImage(path, physicalDevice, cpuMips);
+					loaded.content = TextureCache::contentHash(path);
+				}
+				catch (err::err& error)
+				{
+					logger.log("%s, keeping the placeholder\n", error.what().c_str());
+				}
+				catch (std::exception& error)
+				{
+					// Filesystem errors & running out of memory on a big image, nothing may escape a worker
+
+					logger.log("failed to load %s (%s), keeping the placeholder\n", path.c_str(), error.what());
+
+					if (loaded.image.has_value())
+						for (const auto& level : loaded.image->levels)
+							stagingRing.release(level);
+					loaded.image.reset();
+				}
+
+				std::lock_guard<std::mutex> guard(lock);
+				finished.push_back(std::move(loaded));
+			};
+
+			if (pool == nullptr)
+			{
+				job();
+				return;
+			}
+
+			workers = pool;
+			workers->submit(std::move(job), &group);
+		}
+
+		// Everything decoded since the last call, render thread only
+
+		std::vector<memory::LoadedTexture> collect()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return std::exchange(finished, {});
+		}
+
+		bool idle() const
+		{
+			return group.done();
+		}
+
+		// Waits the decodes out, their staging goes back unused
+
+		void destroy()
+		{
+			if (workers != nullptr)
+				workers->wait(group);
+
+			for (auto& loaded : collect())
+				if (loaded.image.has_value())
+					for (const auto& level : loaded.image->levels)
+						stagingRing.release(level);
+
+			workers = nullptr;
+		}
+	};
+}
\ No newline at end of file
@@ -11,6 +11,22 @@
 
 namespace types
 {
+	// A piece of a device memory block (or a whole allocation when dedicated), handed out by vulkan::deviceAllocator
+
+	struct Allocation
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkDeviceSize offset{ 0u };
+		VkDeviceSize size{ 0u };
+		void* mapped{ nullptr }; // Already offset, only for host visible memory
+
+		std::uint32_t memoryType{ 0u };
+		std::uint32_t pool{ 0u };
+		std::uint32_t block{ 0u };
+		std::uint32_t level{ 0u };
+		bool dedicated{ false };
+	};
+
 	struct VertexInputBindingDescriptors
 	{
 		VkVertexInputBindingDescription main;
@@ -24,6 +40,7 @@ namespace types
 		VkExtent2D extent;
 
 		std::vector<VkImage> images;
+		std::vector<Allocation> imageMemory; // Only offscreen targets own their images, a swapchain's are its own
 	};
 
 	struct graphicsPipelineInformation
@@ -38,16 +55,18 @@ namespace types
 	struct VertexBuffer
 	{
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		Allocation memory;
 
 		VkBuffer index;
-		VkDeviceMemory indexMemory;
+		Allocation indexMemory;
 	};
 
 	struct UniformBuffer
 	{
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		Allocation memory;
+		VkDeviceSize size;
+		void* mapped; // Persistently mapped (host coherent)
 		
 		struct
 		{
@@ -55,12 +74,59 @@ namespace types
 		} uniformData;
 	};
 
+	// One draw out of the vertex & index buffers
+
+	struct DrawCommand
+	{
+		std::uint32_t indexCount{ 3u };
+		std::uint32_t instanceCount{ 1u };
+		std::uint32_t firstIndex{ 0u };
+		std::int32_t vertexOffset{ 0 };
+	};
+
+	// Secondary command buffers of every recorders-th bucket (starting at its index) for a frame, one thread records into them at a time.
+	// Kept from frame to frame, a buffer is only recorded again when its bucket changed
+
+	struct SecondaryRecorder
+	{
+		VkCommandPool pool;
+		std::vector<VkCommandBuffer> buffers;
+	};
+
+	// One per frame in flight, reused once its fence says the GPU is done with it
+
+	struct FrameResources
+	{
+		VkSemaphore imageAvailable;
+		VkSemaphore renderingFinished;
+		VkFence inFlight;
+
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		std::vector<SecondaryRecorder> recorders; // One per recording thread
+		std::vector<std::uint64_t> recordedVersions; // Scene version each bucket's buffer was recorded at, 0 for never
+
+		// What every buffer was recorded against, any of it changing records them all again
+
+		VkExtent2D recordedExtent{};
+		VkPipeline recordedPipeline{ VK_NULL_HANDLE };
+
+		UniformBuffer* uniformBuffer;
+		VkDescriptorSet descriptorSet;
+
+		bool timed{ false }; // Last submit wrote timestamps that haven't been read yet
+		std::uint64_t serial{ 0u }; // Which frame it last submitted, counting from 1
+	};
+
 	struct Texture
 	{
 		VkImage image;
-		VkDeviceMemory memory;
+		Allocation memory;
 		VkImageView view;
 		VkSampler sampler;
+
+		std::uint32_t mipLevels{ 1u };
+		std::uint64_t uploaded{ 0u }; // Transfer timeline value the upload is done at
 	};
 
 	struct Vertex
@@ -4,15 +4,26 @@
 */
 #pragma once
 #include <cstdint>
+#include <deque>
+#include <string>
 #include <vector>
+#include <chrono>
+#include <optional>
+#include <cstring>
+#include <algorithm>
+#include <functional>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include "../../../../utilities/utilFlags.hpp"
 #include "../../../../utilities/console/err.hpp"
+#include "../../../scheduler/parallel.hpp"
 
 #include "builders/builders.hpp"
+#include "textures.hpp"
+#include "texture-cache.hpp"
+#include "draw-list.hpp"
 
 namespace vulkan
 {
@@ -20,7 +31,7 @@ namespace vulkan
 
 	namespace funcs
 	{
-		static auto __stdcall debugLayer(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+		static VKAPI_ATTR VkBool32 VKAPI_CALL debugLayer(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 			VkDebugUtilsMessageTypeFlagsEXT messageType,
 			const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
 			void* pUserData) {
@@ -38,28 +49,225 @@ namespace vulkan
 		VkRenderPass renderPass;
 		VkRenderPass graphicsPass;
 		VkDescriptorPool descriptorPool;
-		VkDescriptorSet descriptorSet;
 
-		types::UniformBuffer* uniformBuffer;
 		types::SwapchainInformation* swapchainInfo;
 		types::graphicsPipelineInformation* graphicsPipelineInfo;
 
-		VkDebugReportCallbackEXT callback;
-		VkSwapchainKHR oldSwapChain{ nullptr };
+		VkDebugUtilsMessengerEXT debugMessenger{ VK_NULL_HANDLE };
+
+		// Headless, swapchainInfo holds our own offscreen images & there's no surface or present queue
+
+		bool headless{ false };
+		VkQueryPool timestampPool{ VK_NULL_HANDLE };
+		float timestampPeriod{ 0.0f };
+
+		// Frames in flight, the CPU records into the current one while the GPU is still drawing the others
+
+		std::vector<types::FrameResources> frames;
+		std::uint32_t currentFrame{ 0u };
+		std::vector<VkFence> imagesInFlight; // Fence of the frame that last drew into each swapchain image
 
-		std::vector<VkCommandBuffer> graphicsCommandBuffers;
 		std::vector<VkImageView> imageViews;
 		std::vector<VkFramebuffer> frameBuffers;
 
+		// What every frame draws, its buckets are recorded into secondary buffers split across the workers (on the render thread alone without them)
+
+		DrawList drawList;
+		zkelp::worker_pool_t* recordingWorkers{ nullptr };
+		std::vector<VkCommandBuffer> secondaries;
+
 		std::vector<types::Texture> textures;
+		types::Texture placeholder; // Sits in the slot of every texture still decoding
+		TextureLoader textureLoader;
+		TextureCache textureCache;
+
+		std::vector<std::uint32_t> freeSlots; // Slots of evicted textures, they hold the placeholder until reused
+		std::vector<std::tuple<types::Texture, std::uint64_t>> retiredTextures; // Evicted, destroyed once every frame that could've used them is done
+		std::uint64_t frameSerial{ 0u }; // Frames submitted so far
+
+		// Destroyed once every frame submitted before they were queued is done (anything those frames could be using)
+
+		std::deque<std::tuple<std::uint64_t, std::function<void()>>> deferredDestroys;
 
 		std::tuple<VkDevice, VkPhysicalDeviceMemoryProperties> logicalDevices;
 		std::tuple<std::uint32_t, std::uint32_t> queueIndexes;
+		std::uint32_t transferQueueIndex{ 0u }; // Dedicated transfer family when there is one, graphics otherwise
 		std::tuple<VkInstance, VkSurfaceKHR> instanceAndSurface;
 		std::tuple<VkQueue, VkQueue> queues;
-		std::tuple<VkSemaphore, VkSemaphore> semaphores;
 		std::tuple<types::VertexBuffer*, types::VertexInputBindingDescriptors*> vertexBufferInfo;
 
+		// 2x2 magenta & black, loud enough to spot anything stuck on it
+
+		void createPlaceholder()
+		{
+			const std::uint32_t pixels[4]{ 0xFFFF00FFu, 0xFF000000u, 0xFF000000u, 0xFFFF00FFu };
+
+			auto [texture, upload] = stageTexture(std::get<0>(logicalDevices), physicalDevice, pixels, 2u, 2u);
+			transferQueue.copyImages({ upload });
+
+			placeholder = texture;
+			placeholder.uploaded = transferQueue.submit();
+		}
+
+		void destroyTexture(types::Texture& texture)
+		{
+			vkDestroySampler(std::get<0>(logicalDevices), texture.sampler, nullptr);
+			vkDestroyImageView(std::get<0>(logicalDevices), texture.view, nullptr);
+			vkDestroyImage(std::get<0>(logicalDevices), texture.image, nullptr);
+			deviceAllocator.free(texture.memory);
+		}
+
+		std::uint32_t allocateSlot()
+		{
+			if (!freeSlots.empty())
+			{
+				const auto slot = freeSlots.back();
+				freeSlots.pop_back();
+				return slot;
+			}
+
+			textures.push_back(placeholder);
+			return static_cast<std::uint32_t>(textures.size() - 1u);
+		}
+
+		// Every frame up to serial is done, each frame's slot either came around since (its fence got waited on first) or its fence is signaled
+
+		bool framesDone(std::uint64_t serial)
+		{
+			return std::all_of(frames.begin(), frames.end(), [&](const auto& frame) {
+				return frame.serial > serial || vkGetFenceStatus(std::get<0>(logicalDevices), frame.inFlight) == VK_SUCCESS;
+			});
+		}
+
+		void defer(std::function<void()> destroy)
+		{
+			deferredDestroys.push_back(std::make_tuple(frameSerial, std::move(destroy)));
+		}
+
+		// Queued in submit order, so it stops at the first one still in use (everything goes when all is set, the device has to be idle)
+
+		void destroyDeferred(bool all)
+		{
+			while (!deferredDestroys.empty() && (all || framesDone(std::get<0>(deferredDestroys.front()))))
+			{
+				std::get<1>(deferredDestroys.front())();
+				deferredDestroys.pop_front();
+			}
+		}
+
+		// Frees the slots of failed loads nobody holds, evicts what the budget doesn't leave room for & destroys what was evicted once
+		// the frames that could sample it are done
+
+		void trimTextures()
+		{
+			for (const auto slot : textureCache.dropFailed())
+				freeSlots.push_back(slot);
+
+			for (const auto slot : textureCache.trim(utils::textureBudget))
+			{
+				retiredTextures.push_back(std::make_tuple(textures[slot], frameSerial));
+				textures[slot] = placeholder;
+				freeSlots.push_back(slot);
+			}
+
+			std::erase_if(retiredTextures, [&](auto& retired) {
+				auto& [texture, serial] = retired;
+				if (!framesDone(serial) || !transferQueue.complete(texture.uploaded))
+					return false;
+
+				destroyTexture(texture);
+				return true;
+			});
+		}
+
+		void destroyPipeline(types::graphicsPipelineInformation* pipelineInfo)
+		{
+			vkDestroyPipeline(std::get<0>(logicalDevices), pipelineInfo->pipeline, nullptr);
+			vkDestroyPipelineLayout(std::get<0>(logicalDevices), pipelineInfo->layout, nullptr);
+			vkDestroyDescriptorSetLayout(std::get<0>(logicalDevices), pipelineInfo->descriptor, nullptr);
+
+			delete pipelineInfo;
+		}
+
+		// Re-recorded every time the frame comes around, its pool is only reset once its fence went through
+
+		void recordFrame(std::uint32_t imageIndex, VkImageLayout targetLayout)
+		{
+			auto& frame = frames[currentFrame];
+			const auto device = std::get<0>(logicalDevices);
+
+			vkResetCommandPool(device, frame.commandPool, 0);
+
+			// A pool for every thread that records (the caller included), command pools can't be shared between threads.
+			// Recorder r owns buckets r, r + recorders, r + 2 * recorders... so one job a recorder never shares one
+
+			const auto threads = recordingWorkers != nullptr ? recordingWorkers->worker_count() + 1u : 1u;
+			if (frame.recorders.size() != threads)
+			{
+				for (const auto& recorder : frame.recorders)
+					vkDestroyCommandPool(device, recorder.pool, nullptr);
+				frame.recorders.clear();
+
+				for (auto i = 0u; i < threads; i++)
+					frame.recorders.push_back({ createCommandPool(device, std::get<0>(queueIndexes), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT), {} });
+
+				frame.recordedVersions.clear();
+			}
+
+			// Anything all the buffers were recorded against changing (a resize, a new pipeline) records them all
+
+			if (frame.recordedExtent.width != swapchainInfo->extent.width || frame.recordedExtent.height != swapchainInfo->extent.height ||
+				frame.recordedPipeline != graphicsPipelineInfo->pipeline)
+			{
+				frame.recordedVersions.clear();
+				frame.recordedExtent = swapchainInfo->extent;
+				frame.recordedPipeline = graphicsPipelineInfo->pipeline;
+			}
+
+			const auto bucketCount = drawList.bucketCount();
+			frame.recordedVersions.resize(bucketCount, 0u);
+
+			// Only the buckets that changed since this frame last recorded them, nothing at all in a static scene
+
+			std::vector<std::uint32_t> dirtyRecorders;
+			for (auto recorder = 0u; recorder < threads; recorder++)
+			{
+				for (auto bucket = static_cast<std::size_t>(recorder); bucket < bucketCount; bucket += threads)
+				{
+					if (frame.recordedVersions[bucket] != drawList.bucketVersion(bucket))
+					{
+						dirtyRecorders.push_back(recorder);
+						break;
+					}
+				}
+			}
+
+			zkelp::parallel::parallel_for(recordingWorkers, 0u, dirtyRecorders.size(), 1u, [&](std::size_t first, std::size_t last) {
+				for (auto job = first; job < last; job++)
+				{
+					const auto recorder = dirtyRecorders[job];
+
+					for (auto bucket = static_cast<std::size_t>(recorder); bucket < bucketCount; bucket += threads)
+					{
+						if (frame.recordedVersions[bucket] == drawList.bucketVersion(bucket))
+							continue;
+
+						recordDraws(secondaryBuffer(device, frame.recorders[recorder], bucket / threads), renderPass, swapchainInfo->extent, std::get<0>(vertexBufferInfo), graphicsPipelineInfo,
+							frame.descriptorSet, drawList.bucketDraws(bucket), drawList.bucketSize(bucket));
+						frame.recordedVersions[bucket] = drawList.bucketVersion(bucket);
+					}
+				}
+			});
+
+			secondaries.resize(bucketCount);
+			for (auto bucket = 0u; bucket < bucketCount; bucket++)
+				secondaries[bucket] = frame.recorders[bucket % threads].buffers[bucket / threads];
+
+			recordCommandBuffer(frame.commandBuffer, renderPass, swapchainInfo, imageIndex, queueIndexes, frameBuffers[imageIndex], secondaries, targetLayout, timestampPool, currentFrame * 2);
+
+			frame.timed = timestampPool != VK_NULL_HANDLE;
+		}
+
 	public:
 		void setup(GLFWwindow* window)
 		{
@@ -70,104 +278,225 @@ namespace vulkan
 			instanceAndSurface = createInstanceAndSurface(window);
 			
 			if constexpr (utils::vulkanDbg)
-				passDebuggerFunc(std::get<0>(instanceAndSurface), funcs::debugLayer);
+				debugMessenger = passDebuggerFunc(std::get<0>(instanceAndSurface), funcs::debugLayer);
 
 			// Setup rest
 
 			physicalDevice = findPhysicalDevice(std::get<0>(instanceAndSurface));
 			queueIndexes = getQueueIndexes(physicalDevice, std::get<1>(instanceAndSurface));
-			logicalDevices = createLogicalDevices(physicalDevice, queueIndexes);
+			transferQueueIndex = findTransferQueueIndex(physicalDevice, std::get<0>(queueIndexes));
+			logicalDevices = createLogicalDevices(physicalDevice, queueIndexes, true, transferQueueIndex);
+			deviceAllocator.init(std::get<0>(logicalDevices), physicalDevice);
+			stagingRing.init(std::get<0>(logicalDevices), utils::stagingRingSize);
 			queues = getQueues(std::get<0>(logicalDevices), queueIndexes);
-			semaphores = createSemaphores(std::get<0>(logicalDevices));
+			transferQueue.init(std::get<0>(logicalDevices), transferQueueIndex, getQueue(std::get<0>(logicalDevices), transferQueueIndex), std::get<0>(queueIndexes), std::get<0>(queues));
+			pipelineCache.init(std::get<0>(logicalDevices), physicalDevice, utils::pipelineCachePath);
 			commandPool = createCommandPool(std::get<0>(logicalDevices), std::get<0>(queueIndexes));
-			vertexBufferInfo = createVertexBuffer(logicalDevices, std::get<0>(queues), commandPool);
-			uniformBuffer = createUniformBuffer(logicalDevices);
-			swapchainInfo = createSwapChain(std::get<0>(logicalDevices), physicalDevice, std::get<1>(instanceAndSurface), oldSwapChain);
+			vertexBufferInfo = createVertexBuffer(logicalDevices);
+			swapchainInfo = createSwapChain(std::get<0>(logicalDevices), physicalDevice, std::get<1>(instanceAndSurface));
 			renderPass = makeRenderPass(std::get<0>(logicalDevices), swapchainInfo->format);
 			imageViews = createImageViews(std::get<0>(logicalDevices), swapchainInfo->format, swapchainInfo->images);
 			frameBuffers = createFrameBuffers(std::get<0>(logicalDevices), renderPass, imageViews, swapchainInfo);
 			graphicsPass = createGraphicsPass(std::get<0>(logicalDevices), swapchainInfo->format);
-			graphicsPipelineInfo = createRenderingPipeline(std::get<0>(logicalDevices), std::get<1>(vertexBufferInfo), renderPass, swapchainInfo->extent);
-			descriptorPool = createDescriptorPool(std::get<0>(logicalDevices));
-			descriptorSet = createDescriptorSet(std::get<0>(logicalDevices), descriptorPool, graphicsPipelineInfo->descriptor, uniformBuffer);
+			graphicsPipelineInfo = createRenderingPipeline(std::get<0>(logicalDevices), std::get<1>(vertexBufferInfo), renderPass);
+
+			// Frames in flight
+
+			const auto frameCount = std::max(utils::framesInFlight, 1u);
+
+			descriptorPool = createDescriptorPool(std::get<0>(logicalDevices), frameCount);
+			frames = createFrames(logicalDevices, std::get<0>(queueIndexes), descriptorPool, graphicsPipelineInfo->descriptor, frameCount);
+			imagesInFlight.assign(swapchainInfo->images.size(), VK_NULL_HANDLE);
 
-			graphicsCommandBuffers = createCommandBuffers(std::get<0>(logicalDevices), commandPool, renderPass, swapchainInfo, queueIndexes, vertexBufferInfo, frameBuffers, graphicsPipelineInfo, descriptorSet);
+			std::tie(timestampPool, timestampPeriod) = createTimestampQueries(std::get<0>(logicalDevices), physicalDevice, std::get<0>(queueIndexes), frameCount);
+
+			textureLoader.init(physicalDevice, !canBlitMips(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB));
+			createPlaceholder();
 		}
 
-		void cleanup(bool fullclean)
+		// Same scene without a window, renders into offscreen images (works on software devices like lavapipe or SwiftShader)
+
+		void setupHeadless(VkExtent2D extent)
 		{
-			vkDeviceWaitIdle(std::get<0>(logicalDevices));
+			headless = true;
 
-			vkFreeCommandBuffers(std::get<0>(logicalDevices), commandPool, graphicsCommandBuffers.size(), graphicsCommandBuffers.data());
+			instanceAndSurface = std::make_tuple(createInstance({}), static_cast<VkSurfaceKHR>(VK_NULL_HANDLE));
 
-			vkDestroyPipeline(std::get<0>(logicalDevices), graphicsPipelineInfo->pipeline, nullptr);
-			vkDestroyRenderPass(std::get<0>(logicalDevices), renderPass, nullptr);
+			if constexpr (utils::vulkanDbg)
+				debugMessenger = passDebuggerFunc(std::get<0>(instanceAndSurface), funcs::debugLayer);
+
+			physicalDevice = findPhysicalDevice(std::get<0>(instanceAndSurface), false);
+			queueIndexes = getGraphicsQueueIndexes(physicalDevice);
+			transferQueueIndex = findTransferQueueIndex(physicalDevice, std::get<0>(queueIndexes));
+			logicalDevices = createLogicalDevices(physicalDevice, queueIndexes, false, transferQueueIndex);
+			deviceAllocator.init(std::get<0>(logicalDevices), physicalDevice);
+			stagingRing.init(std::get<0>(logicalDevices), utils::stagingRingSize);
+			queues = getQueues(std::get<0>(logicalDevices), queueIndexes);
+			transferQueue.init(std::get<0>(logicalDevices), transferQueueIndex, getQueue(std::get<0>(logicalDevices), transferQueueIndex), std::get<0>(queueIndexes), std::get<0>(queues));
+			pipelineCache.init(std::get<0>(logicalDevices), physicalDevice, utils::pipelineCachePath);
+			commandPool = createCommandPool(std::get<0>(logicalDevices), std::get<0>(queueIndexes));
+			vertexBufferInfo = createVertexBuffer(logicalDevices);
+
+			// One offscreen image per frame in flight, so they never wait on each other
+
+			const auto frameCount = std::max(utils::framesInFlight, 1u);
+
+			swapchainInfo = createOffscreenTargets(std::get<0>(logicalDevices), VK_FORMAT_R8G8B8A8_UNORM, extent, frameCount);
+			renderPass = makeRenderPass(std::get<0>(logicalDevices), swapchainInfo->format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+			imageViews = createImageViews(std::get<0>(logicalDevices), swapchainInfo->format, swapchainInfo->images);
+			frameBuffers = createFrameBuffers(std::get<0>(logicalDevices), renderPass, imageViews, swapchainInfo);
+			graphicsPipelineInfo = createRenderingPipeline(std::get<0>(logicalDevices), std::get<1>(vertexBufferInfo), renderPass);
+			descriptorPool = createDescriptorPool(std::get<0>(logicalDevices), frameCount);
+			frames = createFrames(logicalDevices, std::get<0>(queueIndexes), descriptorPool, graphicsPipelineInfo->descriptor, frameCount);
+
+			std::tie(timestampPool, timestampPeriod) = createTimestampQueries(std::get<0>(logicalDevices), physicalDevice, std::get<0>(queueIndexes), frameCount);
+
+			textureLoader.init(physicalDevice, !canBlitMips(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB));
+			createPlaceholder();
+		}
+
+		// Only what's tied to the swapchain's images goes unless it's a full clean
+
+		void cleanup(bool fullclean)
+		{
+			vkDeviceWaitIdle(std::get<0>(logicalDevices));
+			destroyDeferred(true);
 
 			for (auto i = 0u; i < swapchainInfo->images.size(); i++) {
 				vkDestroyFramebuffer(std::get<0>(logicalDevices), frameBuffers[i], nullptr);
 				vkDestroyImageView(std::get<0>(logicalDevices), imageViews[i], nullptr);
 			}
 
-			vkDestroyDescriptorSetLayout(std::get<0>(logicalDevices), graphicsPipelineInfo->descriptor, nullptr);
-
 			if (fullclean) {
+				destroyPipeline(graphicsPipelineInfo);
+				graphicsPipelineInfo = nullptr;
+				vkDestroyRenderPass(std::get<0>(logicalDevices), renderPass, nullptr);
 
-				vkDestroySemaphore(std::get<0>(logicalDevices), std::get<0>(semaphores), nullptr);
-				vkDestroySemaphore(std::get<0>(logicalDevices), std::get<1>(semaphores), nullptr);
+				// Frames in flight (their uniform buffers & descriptor sets included)
 
-				vkDestroyCommandPool(std::get<0>(logicalDevices), commandPool, nullptr);
+				for (const auto& frame : frames)
+				{
+					vkDestroySemaphore(std::get<0>(logicalDevices), frame.imageAvailable, nullptr);
+					vkDestroySemaphore(std::get<0>(logicalDevices), frame.renderingFinished, nullptr);
+					vkDestroyFence(std::get<0>(logicalDevices), frame.inFlight, nullptr);
+					vkDestroyCommandPool(std::get<0>(logicalDevices), frame.commandPool, nullptr);
+
+					for (const auto& recorder : frame.recorders)
+						vkDestroyCommandPool(std::get<0>(logicalDevices), recorder.pool, nullptr);
 
-				// Clean up uniform buffer related objects
+					vkDestroyBuffer(std::get<0>(logicalDevices), frame.uniformBuffer->buffer, nullptr);
+					deviceAllocator.free(frame.uniformBuffer->memory);
+					delete frame.uniformBuffer;
+				}
+
+				frames.clear();
+				imagesInFlight.clear();
+				currentFrame = 0u;
 
+				if (timestampPool != VK_NULL_HANDLE)
+					vkDestroyQueryPool(std::get<0>(logicalDevices), timestampPool, nullptr);
+				timestampPool = VK_NULL_HANDLE;
+
+				vkDestroyCommandPool(std::get<0>(logicalDevices), commandPool, nullptr);
 				vkDestroyDescriptorPool(std::get<0>(logicalDevices), descriptorPool, nullptr);
-				vkDestroyBuffer(std::get<0>(logicalDevices), uniformBuffer->buffer, nullptr);
-				vkFreeMemory(std::get<0>(logicalDevices), uniformBuffer->memory, nullptr);
 
 				// Buffers must be destroyed after no command buffers are referring to them anymore
 
 				vkDestroyBuffer(std::get<0>(logicalDevices), std::get<0>(vertexBufferInfo)->buffer, nullptr);
-				vkFreeMemory(std::get<0>(logicalDevices), std::get<0>(vertexBufferInfo)->memory, nullptr);
+				deviceAllocator.free(std::get<0>(vertexBufferInfo)->memory);
 				vkDestroyBuffer(std::get<0>(logicalDevices), std::get<0>(vertexBufferInfo)->index, nullptr);
-				vkFreeMemory(std::get<0>(logicalDevices), std::get<0>(vertexBufferInfo)->indexMemory, nullptr);
+				deviceAllocator.free(std::get<0>(vertexBufferInfo)->indexMemory);
 
 				// Note: implicitly destroys images (in fact, we're not allowed to do that explicitly)
+				// Offscreen targets are plain images though, those we free ourselves
 
-				vkDestroySwapchainKHR(std::get<0>(logicalDevices), swapchainInfo->swapchain, nullptr);
+				if (!headless)
+					vkDestroySwapchainKHR(std::get<0>(logicalDevices), swapchainInfo->swapchain, nullptr);
 
-				for (auto i = 0u; i < textures.size(); i++)
+				for (auto i = 0u; i < swapchainInfo->imageMemory.size(); i++)
 				{
-					const auto& texture = textures[i];
-
-					vkDestroySampler(std::get<0>(logicalDevices), texture.sampler, nullptr);
-					vkDestroyImageView(std::get<0>(logicalDevices), texture.view, nullptr);
-					vkDestroyImage(std::get<0>(logicalDevices), texture.image, nullptr);
-					vkFreeMemory(std::get<0>(logicalDevices), texture.memory, nullptr);
+					vkDestroyImage(std::get<0>(logicalDevices), swapchainInfo->images[i], nullptr);
+					deviceAllocator.free(swapchainInfo->imageMemory[i]);
 				}
 
+				textureLoader.destroy();
+				textureCache.destroy();
+
+				// Slots still waiting on a decode (or freed) share the placeholder, it's only destroyed once
+
+				for (auto& texture : textures)
+					if (texture.image != placeholder.image)
+						destroyTexture(texture);
+				textures.clear();
+				freeSlots.clear();
+
+				for (auto& [texture, serial] : retiredTextures)
+					destroyTexture(texture);
+				retiredTextures.clear();
+
+				destroyTexture(placeholder);
+				placeholder = {};
+
+				pipelineCache.destroy();
+				transferQueue.destroy();
+				stagingRing.destroy();
+				deviceAllocator.destroy();
 				vkDestroyDevice(std::get<0>(logicalDevices), nullptr);
 
-				vkDestroySurfaceKHR(std::get<0>(instanceAndSurface), std::get<1>(instanceAndSurface), nullptr);
+				if (!headless)
+					vkDestroySurfaceKHR(std::get<0>(instanceAndSurface), std::get<1>(instanceAndSurface), nullptr);
 
-				if constexpr(utils::vulkanDbg) {
-					PFN_vkDestroyDebugReportCallbackEXT DestroyDebugReportCallback = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(std::get<0>(instanceAndSurface), "vkDestroyDebugReportCallbackEXT");
-					DestroyDebugReportCallback(std::get<0>(instanceAndSurface), callback, nullptr);
+				if (debugMessenger != VK_NULL_HANDLE) {
+					const auto DestroyDebugMessenger = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(std::get<0>(instanceAndSurface), "vkDestroyDebugUtilsMessengerEXT"));
+					if (DestroyDebugMessenger != nullptr)
+						DestroyDebugMessenger(std::get<0>(instanceAndSurface), debugMessenger, nullptr);
+					debugMessenger = VK_NULL_HANDLE;
 				}
 
 				vkDestroyInstance(std::get<0>(instanceAndSurface), nullptr);
 			}
 		}
 
+		// Hands over to a new swapchain without draining the GPU, whatever the frames in flight still use of the old one is destroyed once they're done
+
 		void resetView()
 		{
 			windowResized = false;
-			cleanup(false);
 
-			swapchainInfo = createSwapChain(std::get<0>(logicalDevices), physicalDevice, std::get<1>(instanceAndSurface), oldSwapChain);
-			renderPass = makeRenderPass(std::get<0>(logicalDevices), swapchainInfo->format);
+			const auto device = std::get<0>(logicalDevices);
+			const auto retired = swapchainInfo;
+
+			swapchainInfo = createSwapChain(device, physicalDevice, std::get<1>(instanceAndSurface), retired->swapchain);
+
+			defer([device, retired, views = std::move(imageViews), buffers = std::move(frameBuffers)]() {
+				for (const auto frameBuffer : buffers)
+					vkDestroyFramebuffer(device, frameBuffer, nullptr);
+				for (const auto view : views)
+					vkDestroyImageView(device, view, nullptr);
+
+				vkDestroySwapchainKHR(device, retired->swapchain, nullptr);
+				delete retired;
+			});
+
+			// The render pass (& the pipeline built against it) only has to change with the images' format, a new size is just a new viewport
+
+			if (swapchainInfo->format != retired->format)
+			{
+				defer([this, device, pipelineInfo = graphicsPipelineInfo, pass = renderPass]() {
+					destroyPipeline(pipelineInfo);
+					vkDestroyRenderPass(device, pass, nullptr);
+				});
+
+				renderPass = makeRenderPass(std::get<0>(logicalDevices), swapchainInfo->format);
+				graphicsPipelineInfo = createRenderingPipeline(std::get<0>(logicalDevices), std::get<1>(vertexBufferInfo), renderPass);
+			}
+
 			imageViews = createImageViews(std::get<0>(logicalDevices), swapchainInfo->format, swapchainInfo->images);
 			frameBuffers = createFrameBuffers(std::get<0>(logicalDevices), renderPass, imageViews, swapchainInfo);
-			graphicsPipelineInfo = createRenderingPipeline(std::get<0>(logicalDevices), std::get<1>(vertexBufferInfo), renderPass, swapchainInfo->extent);
-			graphicsCommandBuffers = createCommandBuffers(std::get<0>(logicalDevices), commandPool, renderPass, swapchainInfo, queueIndexes, vertexBufferInfo, frameBuffers, graphicsPipelineInfo, descriptorSet);
+
+			// Nothing has drawn into the new images yet
+
+			imagesInFlight.assign(swapchainInfo->images.size(), VK_NULL_HANDLE);
 		}
 
 		void passPresentQueue(std::uint32_t imageIndex)
@@ -175,7 +504,7 @@ namespace vulkan
 			VkPresentInfoKHR presentInfo = {};
 			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 			presentInfo.waitSemaphoreCount = 1;
-			presentInfo.pWaitSemaphores = &std::get<1>(semaphores);
+			presentInfo.pWaitSemaphores = &frames[currentFrame].renderingFinished;
 
 			presentInfo.swapchainCount = 1;
 			presentInfo.pSwapchains = &swapchainInfo->swapchain;
@@ -183,6 +512,10 @@ namespace vulkan
 
 			const auto res = vkQueuePresentKHR(std::get<1>(queues), &presentInfo);
 
+			// Next frame gets the next set, whatever happens to the view
+
+			currentFrame = (currentFrame + 1u) % static_cast<std::uint32_t>(frames.size());
+
 			if (res == VK_SUBOPTIMAL_KHR || res == VK_ERROR_OUT_OF_DATE_KHR || windowResized)
 				resetView();
 			else if(res != VK_SUCCESS)
@@ -191,46 +524,174 @@ namespace vulkan
 
 		void submitImage(std::uint32_t imageIndex)
 		{
+			auto& frame = frames[currentFrame];
+
+			recordFrame(imageIndex, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
 			VkSubmitInfo submitInfo = {};
 			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 			submitInfo.waitSemaphoreCount = 1;
-			submitInfo.pWaitSemaphores = &std::get<0>(semaphores);
+			submitInfo.pWaitSemaphores = &frame.imageAvailable;
 
 			submitInfo.signalSemaphoreCount = 1;
-			submitInfo.pSignalSemaphores = &std::get<1>(semaphores);
+			submitInfo.pSignalSemaphores = &frame.renderingFinished;
 
 			// This is the stage where the queue should wait on the semaphore
 			VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 			submitInfo.pWaitDstStageMask = &waitDstStageMask;
 
 			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &graphicsCommandBuffers[imageIndex];
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
 
-			if (vkQueueSubmit(std::get<0>(queues), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			vkResetFences(std::get<0>(logicalDevices), 1, &frame.inFlight);
+
+			if (vkQueueSubmit(std::get<0>(queues), 1, &submitInfo, frame.inFlight) != VK_SUCCESS)
 				throw err::err("could not submit command buffer");
+
+			frame.serial = ++frameSerial;
+		}
+
+		// Blocks until the GPU is done with the frame's last use, returns how long it spent on it (nothing when the queue has no timestamps)
+
+		std::optional<std::chrono::nanoseconds> waitFrame(std::uint32_t frameIndex)
+		{
+			auto& frame = frames[frameIndex];
+
+			if (vkWaitForFences(std::get<0>(logicalDevices), 1, &frame.inFlight, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+				throw err::err("failed waiting on a frame in flight");
+
+			if (!frame.timed)
+				return {};
+			frame.timed = false;
+
+			std::uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(std::get<0>(logicalDevices), timestampPool, frameIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+				return {};
+
+			return std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(timestamps[1] - timestamps[0]) * timestampPeriod));
 		}
 
 		std::optional<std::uint32_t> acquireImage()
 		{
 			auto imageIndex{ 0u };
 
+			// Only waits when the CPU got a full set of frames ahead of the GPU
+
+			waitFrame(currentFrame);
+			destroyDeferred(false);
+
 			// Device is dangling, so its null. Causes segfault.
 
-			VkResult res = vkAcquireNextImageKHR(std::get<0>(logicalDevices), swapchainInfo->swapchain, UINT64_MAX, std::get<0>(semaphores), VK_NULL_HANDLE, &imageIndex);
+			VkResult res = vkAcquireNextImageKHR(std::get<0>(logicalDevices), swapchainInfo->swapchain, UINT64_MAX, frames[currentFrame].imageAvailable, VK_NULL_HANDLE, &imageIndex);
 
 			if (res == VK_ERROR_OUT_OF_DATE_KHR)
 			{
 				resetView();
 				return {};
 			}
-			else if(res != VK_SUCCESS)
+			else if(res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
 			{
 				throw err::err("couldn't aquire image");
 			}
+
+			// The swapchain may hand back an image an older frame is still drawing into
+
+			if (imagesInFlight[imageIndex] != VK_NULL_HANDLE && imagesInFlight[imageIndex] != frames[currentFrame].inFlight)
+				vkWaitForFences(std::get<0>(logicalDevices), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+			imagesInFlight[imageIndex] = frames[currentFrame].inFlight;
+
 			return std::make_optional(imageIndex);
 		}
 
+		// Replaces what every frame draws from the next one recorded on, workers (when given) record it in parallel & have to outlive their use here
+
+		void setDrawList(std::vector<types::DrawCommand> draws, zkelp::worker_pool_t* workers = nullptr)
+		{
+			drawList.assign(std::move(draws));
+			recordingWorkers = workers;
+		}
+
+		// For changing single draws, only their buckets get recorded again
+
+		DrawList& getDrawList()
+		{
+			return drawList;
+		}
+
+		// Goes into the current frame's uniform buffer, call it between acquireImage & submitImage
+
+		void updateUniforms(const void* data, std::size_t size)
+		{
+			const auto& uniformBuffer = frames[currentFrame].uniformBuffer;
+			std::memcpy(uniformBuffer->mapped, data, std::min(size, static_cast<std::size_t>(uniformBuffer->size)));
+		}
+
+		// Headless frames, there's nothing to acquire or present. Every frame in flight draws into its own offscreen image,
+		// wait on it with waitFrame before submitting it again
+
+		std::uint32_t submitOffscreen()
+		{
+			const auto slot = currentFrame;
+			auto& frame = frames[slot];
+
+			recordFrame(slot, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+			vkResetFences(std::get<0>(logicalDevices), 1, &frame.inFlight);
+
+			if (vkQueueSubmit(std::get<0>(queues), 1, &submitInfo, frame.inFlight) != VK_SUCCESS)
+				throw err::err("could not submit offscreen command buffer");
+
+			frame.serial = ++frameSerial;
+			currentFrame = (currentFrame + 1u) % static_cast<std::uint32_t>(frames.size());
+			return slot;
+		}
+
+		auto getDevice()
+		{
+			return std::get<0>(logicalDevices);
+		}
+
+		auto getPhysicalDevice()
+		{
+			return physicalDevice;
+		}
+
+		auto getRenderPass()
+		{
+			return renderPass;
+		}
+
+		auto getVertexDescriptors()
+		{
+			return std::get<1>(vertexBufferInfo);
+		}
+
+		auto getGraphicsQueue()
+		{
+			return std::get<0>(queues);
+		}
+
+		auto getCommandPool()
+		{
+			return commandPool;
+		}
+
+		auto getCurrentFrame()
+		{
+			return currentFrame;
+		}
+
+		auto getFrameCount()
+		{
+			return static_cast<std::uint32_t>(frames.size());
+		}
+
 		static void onWindowResized(GLFWwindow* window, int width, int height) {
 			windowResized = true;
 		}
@@ -239,11 +700,143 @@ namespace vulkan
 
 		// Make functions
 
-		void makeTexture(const std::string_view& path)
+		// Makes textures from our existing images in one upload. Anything already cached (the same file, size & write time) is shared
+		// instead of loaded again, the handles keep theirs from being evicted
+
+		std::vector<TextureHandle> makeTextures(const std::vector<std::string>& paths)
+		{
+			std::vector<std::uint64_t> hashes;
+			std::vector<std::string> missing;
+			std::vector<std::uint64_t> missingHashes;
+
+			for (const auto& path : paths)
+			{
+				const auto hash = TextureCache::key(path);
+				hashes.push_back(hash);
+
+				if (!textureCache.find(hash).has_value() && std::find(missingHashes.begin(), missingHashes.end(), hash) == missingHashes.end())
+				{
+					missing.push_back(path);
+					missingHashes.push_back(hash);
+				}
+			}
+
+			auto loaded = createTextures(std::get<0>(logicalDevices), physicalDevice, missing);
+
+			// Held until the end so nothing loaded here gets evicted before it's handed out
+
+			std::vector<TextureHandle> created;
+			created.reserve(loaded.size());
+
+			for (auto i = 0u; i < loaded.size(); i++)
+			{
+				const auto slot = allocateSlot();
+				textures[slot] = loaded[i];
+
+				created.push_back(textureCache.insert(missingHashes[i], slot));
+				textureCache.resident(slot, loaded[i].memory.size);
+			}
+
+			std::vector<TextureHandle> handles;
+			handles.reserve(paths.size());
+
+			for (const auto hash : hashes)
+				handles.push_back(textureCache.find(hash).value());
+
+			return handles;
+		}
+
+		// Same without blocking, the images decode on the workers & each slot holds the placeholder until publishTextures swaps it in
+
+		std::vector<TextureHandle> loadTextures(const std::vector<std::string>& paths, zkelp::worker_pool_t* workers)
 		{
-			// Make texture from our existing images
+			std::vector<TextureHandle> handles;
+			handles.reserve(paths.size());
 
-			textures.push_back(createTexture(std::get<0>(logicalDevices), physicalDevice, std::get<0>(queues), commandPool, path));
+			for (const auto& path : paths)
+			{
+				const auto hash = TextureCache::key(path);
+
+				if (auto cached = textureCache.find(hash); cached.has_value())
+				{
+					// A load that failed before gets another go into the same slot
+
+					if (textureCache.reload(hash))
+						textureLoader.request(workers, cached->slot(), path);
+
+					handles.push_back(std::move(cached.value()));
+					continue;
+				}
+
+				const auto slot = allocateSlot();
+				handles.push_back(textureCache.insert(hash, slot));
+
+				textureLoader.request(workers, slot, path);
+			}
+
+			return handles;
+		}
+
+		// Uploads every decode that finished in one submit, call it once a frame before recording. The frames after are ordered behind
+		// the upload, so the new textures can be used by them right away. A decode whose contents are already cached under another path
+		// is dropped & its handles share that copy. Textures nobody holds a handle to get evicted past the budget
+
+		void publishTextures()
+		{
+			auto loaded = textureLoader.collect();
+
+			if (!loaded.empty())
+			{
+				std::vector<memory::ImageUpload> uploads;
+				std::vector<std::uint32_t> published;
+
+				for (auto& texture : loaded)
+				{
+					if (!texture.image.has_value())
+					{
+						textureCache.fail(texture.index);
+						continue;
+					}
+
+					if (textureCache.fold(texture.index, texture.content))
+					{
+						for (const auto& level : texture.image->levels)
+							stagingRing.release(level);
+
+						freeSlots.push_back(texture.index);
+						continue;
+					}
+
+					auto [created, upload] = stageTexture(std::get<0>(logicalDevices), physicalDevice, texture.image.value());
+
+					textures[texture.index] = created;
+					uploads.push_back(upload);
+					published.push_back(texture.index);
+				}
+
+				transferQueue.copyImages(uploads);
+
+				for (const auto& upload : uploads)
+					for (const auto& level : upload.levels)
+						stagingRing.release(level);
+
+				const auto uploaded = transferQueue.submit();
+
+				for (const auto index : published)
+				{
+					textures[index].uploaded = uploaded;
+					textureCache.resident(index, textures[index].memory.size);
+				}
+			}
+
+			trimTextures();
+		}
+
+		// Where a handle's texture is, the placeholder until it's uploaded
+
+		const types::Texture& getTexture(const TextureHandle& handle)
+		{
+			return textures[handle.slot()];
 		}
 
 	} vulkanEngine;
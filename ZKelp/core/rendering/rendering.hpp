@@ -3,15 +3,21 @@
 *	Note: This is still under design choises, so this whole thing might be rewritten differently
 */
 #pragma once
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <chrono>
 #include <mutex>
+#include <vector>
+#include <optional>
+#include <cstdint>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include "../../utilities/utilFlags.hpp"
 #include "../../utilities/console/err.hpp"
+#include "../../utilities/console/logger.hpp"
 
 #include "../scheduler/scheduler.hpp"
 
@@ -27,11 +33,19 @@ namespace zkelp
 		{
 			std::string_view taskName{ "rendering task" };
 			std::once_flag vulkanInit;
+			std::vector<vulkan::TextureHandle> sceneTextures; // Keeps the scene's textures cached
+
+			RenderingTask()
+			{
+				render_bound = true; // The window & presenting have to stay on the thread that made them
+			}
 
 			void cleanScene()
 			{
 				const auto window = dynamic_scheduler.getRenderingWindow();
 
+				sceneTextures.clear();
+
 				if constexpr (utils::useVulkan)
 					vulkan::vulkanEngine.cleanup(true);
 
@@ -62,12 +76,15 @@ namespace zkelp
 
 							vulkan::vulkanEngine.setup(window);
 							glfwSetWindowSizeCallback(window, vulkan::VulkanEngine::onWindowResized);
+							vulkan::vulkanEngine.setDrawList({ types::DrawCommand{} }, dynamic_scheduler.get_workers());
 							
-							// Do fuckups
+							// Do fuckups, decoded on the workers so the first frames go out with the placeholder
 
-							vulkan::vulkanEngine.makeTexture("D:\\Projects\\ZKelp\\x64\\Debug\\resources\\textures\\swag.png");
+							sceneTextures = vulkan::vulkanEngine.loadTextures({ (utils::resourcesPath / "textures" / "swag.png").string() }, dynamic_scheduler.get_workers());
 						});
 
+						vulkan::vulkanEngine.publishTextures();
+
 						// Fetch vulkan stuff
 
 						const auto imageIndex = vulkan::vulkanEngine.acquireImage();
@@ -85,8 +102,121 @@ namespace zkelp
 				else
 				{
 					cleanScene();
+					dynamic_scheduler.stop(); // The window was all we were running for
+					return false;
+				}
+				return true;
+			}
+		};
+
+		// Draws a set number of frames offscreen & logs each one's timings, then shuts itself down (for benchmarks & CI boxes without a GPU)
+
+		struct HeadlessRenderingTask final : public BaseTask
+		{
+			// A frame submitted but not waited on yet, it's reported once its slot comes back around
+
+			struct PendingFrame
+			{
+				std::uint32_t frame{ 0u };
+				std::chrono::nanoseconds cpuTime{ 0 };
+				std::chrono::steady_clock::time_point start;
+			};
+
+			std::once_flag vulkanInit;
+
+			std::uint32_t frameCount;
+			std::uint32_t frame{ 0u };
+
+			std::vector<std::optional<PendingFrame>> pending;
+			std::optional<std::chrono::steady_clock::time_point> lastSubmit;
+
+			latency_histogram_t cpuTimes;
+			latency_histogram_t gpuTimes;
+			latency_histogram_t frameTimes;
+			latency_histogram_t latencies;
+
+			HeadlessRenderingTask(std::uint32_t frames) : frameCount{ frames }
+			{
+				task_name = "headless rendering task";
+				render_bound = true; // Keeps the device on one thread like the windowed one
+			}
+
+			// Frame time is submit to submit, latency is submit to the GPU being done with it
+
+			void logFrame(const PendingFrame& record, std::optional<std::chrono::nanoseconds> gpuTime)
+			{
+				const auto milli = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1'000'000.0; };
+				const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - record.start);
+
+				latencies.record(latency);
+
+				if (gpuTime.has_value())
+				{
+					gpuTimes.record(gpuTime.value());
+					logger.log("frame %u | cpu %.3fms | gpu %.3fms | latency %.3fms\n", record.frame, milli(record.cpuTime), milli(gpuTime.value()), milli(latency));
+				}
+				else
+				{
+					logger.log("frame %u | cpu %.3fms | gpu n/a | latency %.3fms\n", record.frame, milli(record.cpuTime), milli(latency));
+				}
+			}
+
+			void logSummary()
+			{
+				const auto milli = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1'000'000.0; };
+
+				logger.log("headless | %u frames, %u in flight | cpu p50 %.3fms p99 %.3fms | gpu p50 %.3fms p99 %.3fms | frame p50 %.3fms p99 %.3fms max %.3fms | latency p50 %.3fms p99 %.3fms\n",
+					frameCount, static_cast<std::uint32_t>(pending.size()), milli(cpuTimes.percentile(50.0)), milli(cpuTimes.percentile(99.0)), milli(gpuTimes.percentile(50.0)), milli(gpuTimes.percentile(99.0)),
+					milli(frameTimes.percentile(50.0)), milli(frameTimes.percentile(99.0)), milli(frameTimes.max()), milli(latencies.percentile(50.0)), milli(latencies.percentile(99.0)));
+			}
+
+			virtual bool mainTick()
+			{
+				std::call_once(vulkanInit, [this] {
+					vulkan::vulkanEngine.setupHeadless({ utils::windowInformation[0], utils::windowInformation[1] });
+					pending.resize(vulkan::vulkanEngine.getFrameCount());
+				});
+
+				if (frame >= frameCount)
+				{
+					// Drain whatever's still in flight
+
+					for (auto slot = 0u; slot < pending.size(); slot++)
+					{
+						const auto gpuTime = vulkan::vulkanEngine.waitFrame(slot);
+						if (pending[slot].has_value())
+							logFrame(pending[slot].value(), gpuTime);
+						pending[slot].reset();
+					}
+
+					logSummary();
+					vulkan::vulkanEngine.cleanup(true);
+					dynamic_scheduler.stop();
 					return false;
 				}
+
+				// The slot's previous frame has to be done before it can be recorded again, with more than one in flight it usually is
+
+				const auto slot = vulkan::vulkanEngine.getCurrentFrame();
+				const auto gpuTime = vulkan::vulkanEngine.waitFrame(slot);
+
+				if (pending[slot].has_value())
+					logFrame(pending[slot].value(), gpuTime);
+
+				// Cpu time is the recording & submit
+
+				const auto start = std::chrono::steady_clock::now();
+				vulkan::vulkanEngine.submitOffscreen();
+				const auto cpuTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+				cpuTimes.record(cpuTime);
+				if (lastSubmit.has_value())
+					frameTimes.record(start - lastSubmit.value());
+				lastSubmit = start;
+
+				pending[slot] = PendingFrame{ frame, cpuTime, start };
+
+				frame++;
 				return true;
 			}
 		};
@@ -117,6 +247,17 @@ namespace zkelp
 		dynamic_scheduler.add_task(mainRenderTask);
 		return mainRenderTask;
 	}
+
+	// No glfw at all, vulkan gets set up on the first tick without a surface
+
+	static scheduler_types::HeadlessRenderingTask* initHeadlessRenderer(std::uint32_t frames)
+	{
+		auto headlessRenderTask(new scheduler_types::HeadlessRenderingTask(frames));
+
+		dynamic_scheduler.change_headless(true);
+		dynamic_scheduler.add_task(headlessRenderTask);
+		return headlessRenderTask;
+	}
 }
 
 #undef UGLY_VULKAN
\ No newline at end of file
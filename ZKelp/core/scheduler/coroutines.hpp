@@ -0,0 +1,300 @@
+/*
+*	Desc: Coroutine tasks
+*	Note: Multi-frame logic written straight down with co_await, frames come from a pool. Suspending on a frame, a timer or a fence never
+*	allocates, run_job does (its hand-off to the workers)
+*/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <string_view>
+#include <variant>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include "../../utilities/console/err.hpp"
+#include "../../utilities/console/logger.hpp"
+#include "scheduler.hpp"
+#include "frames.hpp"
+
+namespace zkelp
+{
+	namespace coroutines
+	{
+		struct co_task_t
+		{
+			struct promise_type
+			{
+				// What we're suspended on, the owning task polls it every tick & resumes once it says so (nothing means next tick)
+
+				bool (*ready)(void*) { nullptr };
+				void* context{ nullptr };
+				std::exception_ptr exception;
+
+				// The owning task & every job in flight hold the frame, the last one to let go deletes the task (and the frame with it)
+
+				std::atomic<std::uint32_t> holders{ 1u };
+				void* owner{ nullptr };
+				void (*destroy_owner)(void*) { nullptr };
+
+				void hold()
+				{
+					holders.fetch_add(1u, std::memory_order_relaxed);
+				}
+
+				void release()
+				{
+					if (holders.fetch_sub(1u, std::memory_order_acq_rel) == 1u && destroy_owner != nullptr)
+						destroy_owner(owner);
+				}
+
+				co_task_t get_return_object()
+				{
+					return co_task_t{ std::coroutine_handle<promise_type>::from_promise(*this) };
+				}
+
+				std::suspend_always initial_suspend() noexcept { return {}; } // First resume happens on the first tick
+				std::suspend_always final_suspend() noexcept { return {}; } // The task tears the frame down once it's removed
+
+				void return_void() {}
+
+				void unhandled_exception()
+				{
+					exception = std::current_exception();
+				}
+
+				static void* operator new(std::size_t size)
+				{
+					return coroutine_frames.allocate(size);
+				}
+
+				static void operator delete(void* ptr, std::size_t size)
+				{
+					coroutine_frames.release(ptr, size);
+				}
+			};
+
+			std::coroutine_handle<promise_type> handle;
+
+			explicit co_task_t(std::coroutine_handle<promise_type> handle) : handle{ handle } {}
+			co_task_t(co_task_t&& other) noexcept : handle{ std::exchange(other.handle, nullptr) } {}
+			co_task_t(const co_task_t&) = delete;
+
+			~co_task_t()
+			{
+				if (handle)
+					handle.destroy();
+			}
+		};
+
+		using co_handle_t = std::coroutine_handle<co_task_t::promise_type>;
+
+		// Awaitables, every one of them resumes on a later tick of the task that owns the coroutine
+
+		struct next_frame
+		{
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(co_handle_t) const noexcept {}
+			void await_resume() const noexcept {}
+		};
+
+		struct wait_for
+		{
+			std::chrono::steady_clock::time_point deadline;
+
+			template<typename _Rep, typename _Period>
+			wait_for(std::chrono::duration<_Rep, _Period> duration) : deadline{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration) } {}
+
+			bool await_ready() const noexcept
+			{
+				return std::chrono::steady_clock::now() >= deadline;
+			}
+
+			void await_suspend(co_handle_t handle) noexcept
+			{
+				auto& promise = handle.promise();
+				promise.context = this;
+				promise.ready = [](void* context) {
+					return std::chrono::steady_clock::now() >= static_cast<wait_for*>(context)->deadline;
+				};
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		// Runs a callable on the workers, co_await gives back what it returned (or throws what it threw, back in the coroutine). The job
+		// holds the frame it writes into, so removing the task meanwhile only deletes it once the job's done
+
+		template<typename _Fn>
+		struct run_job
+		{
+			using result_t = std::invoke_result_t<_Fn>;
+			using stored_t = std::conditional_t<std::is_void_v<result_t>, std::monostate, result_t>;
+
+			_Fn to_run;
+			std::optional<stored_t> result;
+			std::exception_ptr exception;
+			std::atomic<bool> done{ false };
+
+			run_job(_Fn to_run) : to_run{ std::move(to_run) } {}
+
+			bool await_ready() const noexcept { return false; }
+
+			void await_suspend(co_handle_t handle)
+			{
+				auto& promise = handle.promise();
+				promise.context = this;
+				promise.ready = [](void* context) {
+					return static_cast<run_job*>(context)->done.load(std::memory_order_acquire);
+				};
+
+				promise.hold();
+
+				dynamic_scheduler.submit_job([this, &promise] {
+					try
+					{
+						if constexpr (std::is_void_v<result_t>)
+						{
+							to_run();
+							result.emplace();
+						}
+						else
+						{
+							result.emplace(to_run());
+						}
+					}
+					catch (...)
+					{
+						exception = std::current_exception();
+					}
+
+					done.store(true, std::memory_order_release);
+					promise.release();
+				});
+			}
+
+			result_t await_resume()
+			{
+				if (exception)
+					std::rethrow_exception(exception);
+
+				if constexpr (!std::is_void_v<result_t>)
+					return std::move(result.value());
+			}
+		};
+
+		struct gpu_fence
+		{
+			VkDevice device;
+			VkFence fence;
+
+			bool await_ready() const noexcept
+			{
+				return vkGetFenceStatus(device, fence) == VK_SUCCESS;
+			}
+
+			void await_suspend(co_handle_t handle) noexcept
+			{
+				auto& promise = handle.promise();
+				promise.context = this;
+				promise.ready = [](void* context) {
+					const auto awaiter = static_cast<gpu_fence*>(context);
+					return vkGetFenceStatus(awaiter->device, awaiter->fence) == VK_SUCCESS;
+				};
+			}
+
+			void await_resume() const noexcept {}
+		};
+	}
+
+	namespace scheduler_types
+	{
+		// Owns a coroutine & steps it once it's ready, deletes itself once the scheduler & any job it's waiting on let go of it
+
+		struct coroutineTask final : BaseTask
+		{
+			coroutines::co_task_t routine;
+
+			SCHEDULER_TYPEID;
+
+			coroutineTask(coroutines::co_task_t&& routine, std::string_view name) : routine{ std::move(routine) }
+			{
+				task_name = name;
+
+				auto& promise = this->routine.handle.promise();
+				promise.owner = this;
+				promise.destroy_owner = [](void* task) { delete static_cast<coroutineTask*>(task); };
+			}
+
+			virtual bool mainTick()
+			{
+				auto& promise = routine.handle.promise();
+
+				if (promise.ready != nullptr && !promise.ready(promise.context))
+					return true;
+
+				promise.ready = nullptr;
+				promise.context = nullptr;
+				routine.handle.resume();
+
+				// Ticks run on the workers & nothing up there catches, so a throwing coroutine is logged & removed
+
+				if (promise.exception)
+				{
+					try
+					{
+						std::rethrow_exception(promise.exception);
+					}
+					catch (err::err& error)
+					{
+						logger.log("%.*s threw \"%s\", removing it\n", static_cast<int>(task_name.size()), task_name.data(), error.what().c_str());
+					}
+					catch (std::exception& error)
+					{
+						logger.log("%.*s threw \"%s\", removing it\n", static_cast<int>(task_name.size()), task_name.data(), error.what());
+					}
+					catch (...)
+					{
+						logger.log("%.*s threw, removing it\n", static_cast<int>(task_name.size()), task_name.data());
+					}
+					return false;
+				}
+
+				return !routine.handle.done();
+			}
+
+			// Deleted right away unless a run_job is still writing into the frame, then the job does it once it's done
+
+			virtual void onRemoved()
+			{
+				routine.handle.promise().release();
+			}
+
+			static void* operator new(std::size_t size)
+			{
+				return coroutine_frames.allocate(size);
+			}
+
+			static void operator delete(void* ptr, std::size_t size)
+			{
+				coroutine_frames.release(ptr, size);
+			}
+		};
+	}
+
+	namespace coroutines
+	{
+		// Hands a coroutine to the scheduler, safe from any thread
+
+		static auto spawn(co_task_t&& routine, std::string_view name = "coroutine")
+		{
+			const auto task = new scheduler_types::coroutineTask(std::move(routine), name);
+			dynamic_scheduler.add_task(task);
+			return task;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+*	Desc: Coroutine frame pool
+*	Note: Declared ahead of the scheduler so it outlives the scheduler thread on exit
+*/
+#pragma once
+#include <new>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace zkelp
+{
+	// Size classed free lists carved out of big chunks, anything bigger than the last class goes to the heap
+
+	class frame_pool_t
+	{
+		static constexpr std::size_t smallest_block{ 64u };
+		static constexpr std::size_t class_count{ 8u }; // 64 bytes up to 8 KiB
+		static constexpr std::size_t chunk_size{ 64u * 1024u };
+
+		struct free_block_t
+		{
+			free_block_t* next;
+		};
+
+		std::array<free_block_t*, class_count> free_lists{};
+		std::vector<std::unique_ptr<std::byte[]>> chunks;
+		std::atomic_flag busy;
+
+		struct spin_guard_t
+		{
+			std::atomic_flag& flag;
+
+			spin_guard_t(std::atomic_flag& flag) : flag{ flag }
+			{
+				while (flag.test_and_set(std::memory_order_acquire))
+					flag.wait(true, std::memory_order_relaxed);
+			}
+
+			~spin_guard_t()
+			{
+				flag.clear(std::memory_order_release);
+				flag.notify_one();
+			}
+		};
+
+		static std::size_t size_class(std::size_t size)
+		{
+			auto index{ 0u };
+			while ((smallest_block << index) < size)
+				index++;
+			return index;
+		}
+
+		void refill(std::size_t index)
+		{
+			const auto block = smallest_block << index;
+
+			chunks.push_back(std::make_unique<std::byte[]>(chunk_size));
+			const auto chunk = chunks.back().get();
+
+			for (auto offset = 0u; offset + block <= chunk_size; offset += block)
+			{
+				const auto free = reinterpret_cast<free_block_t*>(chunk + offset);
+				free->next = free_lists[index];
+				free_lists[index] = free;
+			}
+		}
+	public:
+
+		static constexpr std::size_t largest_block{ smallest_block << (class_count - 1u) };
+
+		void* allocate(std::size_t size)
+		{
+			if (size > largest_block)
+				return ::operator new(size);
+
+			const auto index = size_class(size);
+			spin_guard_t guard(busy);
+
+			if (free_lists[index] == nullptr)
+				refill(index);
+
+			const auto block = free_lists[index];
+			free_lists[index] = block->next;
+			return block;
+		}
+
+		void release(void* ptr, std::size_t size)
+		{
+			if (size > largest_block)
+			{
+				::operator delete(ptr);
+				return;
+			}
+
+			const auto index = size_class(size);
+			spin_guard_t guard(busy);
+
+			const auto block = static_cast<free_block_t*>(ptr);
+			block->next = free_lists[index];
+			free_lists[index] = block;
+		}
+	} coroutine_frames;
+}
\ No newline at end of file
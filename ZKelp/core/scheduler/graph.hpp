@@ -0,0 +1,298 @@
+/*
+*	Desc: Task dependency graph
+*	Note: Only rebuilt when the task list changes, every tick a task is handed out the moment its last dependency finishes
+*/
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+#include "tasks.hpp"
+#include "workers.hpp"
+
+#include "../../utilities/console/logger.hpp"
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		struct frame_stats_t
+		{
+			std::chrono::steady_clock::duration frame_time{};		// Frame start until the last task finished
+			std::chrono::steady_clock::duration critical_path{};	// Longest chain of dependent task ticks
+			std::string_view critical_task{};						// Task the critical path ends on
+			std::uint32_t critical_length{ 0u };					// Tasks on the critical path
+		};
+	}
+
+	class task_graph_t
+	{
+		using clock = std::chrono::steady_clock;
+
+		std::vector<scheduler_types::BaseTask*> nodes;
+		std::vector<std::vector<std::uint32_t>> dependents;
+		std::vector<std::vector<std::uint32_t>> dependencies;
+		std::vector<std::uint32_t> order; // Topological
+		std::unordered_map<scheduler_types::BaseTask*, std::uint32_t> index;
+		std::uint32_t pinned_count{ 0u };
+
+		// Per tick state
+
+		std::unique_ptr<std::atomic<std::uint32_t>[]> remaining;
+		std::vector<clock::time_point> started;
+		std::vector<clock::time_point> finished;
+		std::vector<std::uint8_t> results;
+
+		std::atomic<std::uint32_t> outstanding{ 0u };
+		std::atomic<std::uint32_t> pinned_signal{ 0u };
+		std::mutex pinned_lock;
+		std::vector<std::uint32_t> pinned_ready;
+
+		worker_pool_t* workers{ nullptr };
+		scheduler_types::job_group_t group;
+
+		void link(const std::vector<std::uint8_t>& cut)
+		{
+			const auto count = static_cast<std::uint32_t>(nodes.size());
+
+			dependents.assign(count, {});
+			dependencies.assign(count, {});
+
+			for (auto i = 0u; i < count; i++)
+			{
+				for (const auto dependency : nodes[i]->depends_on)
+				{
+					// Dependencies that aren't scheduled (finished or never added) don't hold anything up
+
+					const auto found = index.find(dependency);
+					if (found == index.end() || found->second == i)
+						continue;
+
+					if (cut[i] && cut[found->second])
+						continue;
+
+					dependencies[i].push_back(found->second);
+					dependents[found->second].push_back(i);
+				}
+			}
+		}
+
+		// Kahn's algorithm, returns whether every node made it in
+
+		bool sort()
+		{
+			const auto count = static_cast<std::uint32_t>(nodes.size());
+
+			std::vector<std::uint32_t> incoming(count);
+			for (auto i = 0u; i < count; i++)
+				incoming[i] = static_cast<std::uint32_t>(dependencies[i].size());
+
+			order.clear();
+			for (auto i = 0u; i < count; i++)
+				if (!incoming[i])
+					order.push_back(i);
+
+			for (auto i = 0u; i < order.size(); i++)
+				for (const auto dependent : dependents[order[i]])
+					if (--incoming[dependent] == 0u)
+						order.push_back(dependent);
+
+			return order.size() == count;
+		}
+
+		void dispatch(std::uint32_t node)
+		{
+			if (nodes[node]->render_bound)
+			{
+				{
+					std::lock_guard guard(pinned_lock);
+					pinned_ready.push_back(node);
+				}
+
+				pinned_signal.fetch_add(1u, std::memory_order_release);
+				pinned_signal.notify_one();
+				return;
+			}
+
+			workers->submit([this, node] { execute(node); }, &group);
+		}
+
+		void execute(std::uint32_t node)
+		{
+			started[node] = clock::now();
+			results[node] = nodes[node]->mainTick();
+			finished[node] = clock::now();
+
+			for (const auto dependent : dependents[node])
+				if (remaining[dependent].fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+					dispatch(dependent);
+
+			if (outstanding.fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+			{
+				pinned_signal.fetch_add(1u, std::memory_order_release);
+				pinned_signal.notify_one();
+			}
+		}
+
+		std::optional<std::uint32_t> pop_pinned()
+		{
+			std::lock_guard guard(pinned_lock);
+			if (pinned_ready.empty())
+				return {};
+
+			const auto node = pinned_ready.back();
+			pinned_ready.pop_back();
+			return node;
+		}
+	public:
+
+		void rebuild(const std::vector<scheduler_types::BaseTask*>& tasks)
+		{
+			nodes = tasks;
+
+			const auto count = static_cast<std::uint32_t>(nodes.size());
+
+			index.clear();
+			for (auto i = 0u; i < count; i++)
+				index[nodes[i]] = i;
+
+			std::vector<std::uint8_t> cut(count, 0u);
+			link(cut);
+
+			if (!sort())
+			{
+				// Tasks left over sit on (or behind) a cycle, drop the edges between them so they still get to run
+
+				std::vector<std::uint8_t> sorted(count, 0u);
+				for (const auto node : order)
+					sorted[node] = 1u;
+
+				for (auto i = 0u; i < count; i++)
+				{
+					if (!sorted[i])
+					{
+						cut[i] = 1u;
+						logger.log("task \"%s\" is stuck on a dependency cycle, ignoring its dependencies there\n", nodes[i]->task_name.data());
+					}
+				}
+
+				link(cut);
+				sort();
+			}
+
+			pinned_count = 0u;
+			for (const auto task : nodes)
+				if (task->render_bound)
+					pinned_count++;
+
+			remaining = std::make_unique<std::atomic<std::uint32_t>[]>(count);
+			started.resize(count);
+			finished.resize(count);
+			results.resize(count);
+		}
+
+		// Ticks every node once & gives back what each mainTick returned, pinned tasks run on the calling thread
+
+		const std::vector<std::uint8_t>& run(worker_pool_t* pool)
+		{
+			workers = pool;
+
+			const auto count = static_cast<std::uint32_t>(nodes.size());
+			if (!count)
+				return results;
+
+			for (auto i = 0u; i < count; i++)
+				remaining[i].store(static_cast<std::uint32_t>(dependencies[i].size()), std::memory_order_relaxed);
+
+			outstanding.store(count, std::memory_order_release);
+
+			for (auto i = 0u; i < count; i++)
+				if (dependencies[i].empty())
+					dispatch(i);
+
+			// Run pinned tasks as they get ready, once they're all done just help the workers finish
+
+			auto pinned_left = pinned_count;
+
+			while (outstanding.load(std::memory_order_acquire) != 0u)
+			{
+				if (!pinned_left)
+				{
+					workers->wait(group);
+					continue;
+				}
+
+				const auto seen = pinned_signal.load(std::memory_order_acquire);
+
+				if (const auto node = pop_pinned())
+				{
+					execute(node.value());
+					pinned_left--;
+					continue;
+				}
+
+				if (outstanding.load(std::memory_order_acquire) != 0u)
+					pinned_signal.wait(seen, std::memory_order_acquire);
+			}
+
+			workers->wait(group);
+			return results;
+		}
+
+		// How long a node's last tick took
+
+		clock::duration tick_time(std::uint32_t node) const
+		{
+			return finished[node] - started[node];
+		}
+
+		// Critical path of the last run, walked in topological order
+
+		scheduler_types::frame_stats_t measure(clock::time_point frame_start) const
+		{
+			scheduler_types::frame_stats_t stats;
+
+			const auto count = nodes.size();
+			if (!count)
+				return stats;
+
+			std::vector<clock::duration> chain(count, clock::duration::zero());
+			std::vector<std::uint32_t> length(count, 0u);
+
+			for (const auto node : order)
+			{
+				clock::duration longest{ clock::duration::zero() };
+				std::uint32_t longest_length{ 0u };
+
+				for (const auto dependency : dependencies[node])
+				{
+					if (chain[dependency] > longest)
+					{
+						longest = chain[dependency];
+						longest_length = length[dependency];
+					}
+				}
+
+				chain[node] = longest + (finished[node] - started[node]);
+				length[node] = longest_length + 1u;
+
+				if (chain[node] >= stats.critical_path)
+				{
+					stats.critical_path = chain[node];
+					stats.critical_task = nodes[node]->task_name;
+					stats.critical_length = length[node];
+				}
+
+				stats.frame_time = std::max(stats.frame_time, finished[node] - frame_start);
+			}
+
+			return stats;
+		}
+	};
+}
\ No newline at end of file
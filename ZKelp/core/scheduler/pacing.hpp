@@ -0,0 +1,137 @@
+/*
+*	Desc: Frame pacing
+*	Note: Works off an absolute deadline, it sleeps most of the wait & spins the last bit so frames land on time
+*/
+#pragma once
+#include <chrono>
+#include <thread>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		enum class pacing_mode
+		{
+			uncapped,		// Tick as fast as possible
+			target_fps,		// One tick per frame, frames spaced by 1 / rate
+			fixed_timestep	// Ticks are steps of 1 / rate, a late frame may run several to catch up
+		};
+
+		enum class overrun_policy
+		{
+			catch_up,	// Keep the old deadlines & run late frames back to back until caught up
+			skip		// Forget the missed frames & start counting again from now
+		};
+
+		struct frame_pacing_t
+		{
+			pacing_mode mode{ pacing_mode::uncapped };
+			double rate{ 60.0 }; // Frames (or steps) per second
+
+			std::chrono::microseconds spin_window{ 500 }; // Spun instead of slept right before the deadline
+			overrun_policy on_overrun{ overrun_policy::skip };
+			std::uint32_t max_catch_up{ 4u }; // Falling further behind than this always skips
+		};
+	}
+
+	class frame_pacer_t
+	{
+		using clock = std::chrono::steady_clock;
+
+		scheduler_types::frame_pacing_t settings;
+		clock::time_point deadline;
+		bool started{ false };
+
+		void wait_until(clock::time_point target)
+		{
+			const auto sleep_target = target - settings.spin_window;
+
+			if (clock::now() < sleep_target)
+				std::this_thread::sleep_until(sleep_target);
+
+			while (clock::now() < target)
+				std::this_thread::yield();
+		}
+	public:
+
+		void configure(const scheduler_types::frame_pacing_t& new_settings)
+		{
+			settings = new_settings;
+			settings.rate = std::max(settings.rate, 1.0);
+			settings.max_catch_up = std::max(settings.max_catch_up, 1u);
+			started = false;
+		}
+
+		const auto& get_settings() const
+		{
+			return settings;
+		}
+
+		// Frame budget, zero when uncapped
+
+		clock::duration period() const
+		{
+			if (settings.mode == scheduler_types::pacing_mode::uncapped)
+				return clock::duration::zero();
+
+			return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / settings.rate));
+		}
+
+		// When the next frame is due, nothing when uncapped
+
+		std::optional<clock::time_point> next_deadline() const
+		{
+			if (!started || settings.mode == scheduler_types::pacing_mode::uncapped)
+				return {};
+			return deadline + period();
+		}
+
+		// Waits for the next frame & returns how many ticks it should run
+
+		std::uint32_t wait_next()
+		{
+			if (settings.mode == scheduler_types::pacing_mode::uncapped)
+				return 1u;
+
+			const auto step = period();
+			auto now = clock::now();
+
+			if (!started)
+			{
+				started = true;
+				deadline = now;
+				return 1u;
+			}
+
+			deadline += step;
+
+			if (now < deadline)
+			{
+				wait_until(deadline);
+				return 1u;
+			}
+
+			// Overran, figure out how far behind we are
+
+			const auto behind = static_cast<std::uint32_t>((now - deadline) / step) + 1u;
+
+			if (settings.on_overrun == scheduler_types::overrun_policy::skip || behind > settings.max_catch_up)
+			{
+				deadline = now;
+				return 1u;
+			}
+
+			// Catching up, a fixed timestep runs the missed steps right away, a frame rate just stops waiting until it's back on time
+
+			if (settings.mode == scheduler_types::pacing_mode::fixed_timestep)
+			{
+				deadline += step * (behind - 1u);
+				return behind;
+			}
+			return 1u;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+/*
+*	Desc: Data parallel loops
+*	Note: Ranges get split in halves onto the worker deques, the caller helps out while it waits so nesting never adds threads
+*/
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "workers.hpp"
+#include "scheduler.hpp"
+
+namespace zkelp
+{
+	namespace parallel
+	{
+		// Picks a grain so each worker (and the caller) gets a few chunks to balance with
+
+		static std::size_t auto_grain(worker_pool_t* pool, std::size_t count)
+		{
+			const auto threads = static_cast<std::size_t>(pool != nullptr ? pool->worker_count() + 1u : 1u);
+			return std::max<std::size_t>(count / (threads * 4u), 1u);
+		}
+
+		// Hands the upper half of the range off until what's left fits in a grain, the idle workers steal the big halves first
+
+		template<typename _Fn>
+		static void split(worker_pool_t* pool, scheduler_types::job_group_t* group, std::size_t begin, std::size_t end, std::size_t grain, const _Fn* body)
+		{
+			while (end - begin > grain)
+			{
+				const auto middle = begin + (end - begin) / 2u;
+				pool->submit([=] { split(pool, group, middle, end, grain, body); }, group);
+				end = middle;
+			}
+
+			(*body)(begin, end);
+		}
+
+		// Calls body(chunk_begin, chunk_end) over [begin, end) in chunks of at most grain (0 picks one), returns once every chunk ran
+
+		template<typename _Fn>
+		static void parallel_for(worker_pool_t* pool, std::size_t begin, std::size_t end, std::size_t grain, _Fn&& body)
+		{
+			if (begin >= end)
+				return;
+
+			const auto count = end - begin;
+			if (!grain)
+				grain = auto_grain(pool, count);
+
+			// Nothing to spread it over (or not worth it)
+
+			if (pool == nullptr || count <= grain)
+			{
+				body(begin, end);
+				return;
+			}
+
+			scheduler_types::job_group_t group;
+			split(pool, &group, begin, end, grain, &body);
+			pool->wait(group);
+		}
+
+		// Same, on the scheduler's workers
+
+		template<typename _Fn>
+		static void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, _Fn&& body)
+		{
+			parallel_for(dynamic_scheduler.get_workers(), begin, end, grain, std::forward<_Fn>(body));
+		}
+
+		// Every chunk is reduced on its own with map(chunk_begin, chunk_end), the partials are combined in order so the result doesn't depend on timing
+
+		template<typename _Ty, typename _Map, typename _Combine>
+		static _Ty parallel_reduce(worker_pool_t* pool, std::size_t begin, std::size_t end, std::size_t grain, _Ty identity, _Map&& map, _Combine&& combine)
+		{
+			if (begin >= end)
+				return identity;
+
+			const auto count = end - begin;
+			if (!grain)
+				grain = auto_grain(pool, count);
+
+			// One cache line per chunk, a plain vector would be vector<bool> for bools & neighbouring chunks would share words
+
+			struct alignas(64) partial_t
+			{
+				_Ty value;
+			};
+
+			const auto chunks = (count + grain - 1u) / grain;
+			std::vector<partial_t> partials(chunks, partial_t{ identity });
+
+			parallel_for(pool, 0u, chunks, 1u, [&](std::size_t first, std::size_t last) {
+				for (auto chunk = first; chunk < last; chunk++)
+				{
+					const auto chunk_begin = begin + chunk * grain;
+					partials[chunk].value = map(chunk_begin, std::min(chunk_begin + grain, end));
+				}
+			});
+
+			auto result = identity;
+			for (auto& partial : partials)
+				result = combine(std::move(result), std::move(partial.value));
+			return result;
+		}
+
+		template<typename _Ty, typename _Map, typename _Combine>
+		static _Ty parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, _Ty identity, _Map&& map, _Combine&& combine)
+		{
+			return parallel_reduce(dynamic_scheduler.get_workers(), begin, end, grain, std::move(identity), std::forward<_Map>(map), std::forward<_Combine>(combine));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*
+*	Desc: Task profiling
+*	Note: Log-linear histograms of how long every tick took, recorded by the scheduler thread & readable from anywhere
+*/
+#pragma once
+#include <atomic>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+#include "../../utilities/console/logger.hpp"
+
+namespace zkelp
+{
+	// Every power of two is split into 16 buckets, so a value lands within ~6% of where it's reported
+
+	class latency_histogram_t
+	{
+		static constexpr std::uint32_t sub_bits{ 4u };
+		static constexpr std::uint32_t sub_count{ 1u << sub_bits };
+		static constexpr std::uint32_t top_exponent{ 39u }; // ~9 minutes in nanoseconds, anything longer is clamped
+		static constexpr std::uint32_t bucket_count{ (top_exponent - sub_bits + 2u) * sub_count };
+
+		// Single writer, so plain relaxed stores are enough & readers never see a torn value
+
+		std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+		std::atomic<std::uint64_t> count{ 0u };
+		std::atomic<std::uint64_t> total{ 0u };
+		std::atomic<std::uint64_t> highest{ 0u };
+
+		static std::uint32_t bucket_of(std::uint64_t value)
+		{
+			if (value < sub_count)
+				return static_cast<std::uint32_t>(value);
+
+			auto exponent = static_cast<std::uint32_t>(std::bit_width(value)) - 1u;
+			if (exponent > top_exponent)
+				return bucket_count - 1u;
+
+			const auto sub = static_cast<std::uint32_t>(value >> (exponent - sub_bits)) & (sub_count - 1u);
+			return (exponent - sub_bits + 1u) * sub_count + sub;
+		}
+
+		// Highest value that still lands in the bucket
+
+		static std::uint64_t bucket_ceiling(std::uint32_t bucket)
+		{
+			if (bucket < sub_count)
+				return bucket;
+
+			const auto exponent = bucket / sub_count + sub_bits - 1u;
+			const auto sub = static_cast<std::uint64_t>(bucket % sub_count);
+			return ((sub_count + sub + 1u) << (exponent - sub_bits)) - 1u;
+		}
+
+		static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by = 1u)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+		}
+	public:
+
+		using clock = std::chrono::steady_clock;
+
+		void record(clock::duration duration)
+		{
+			const auto value = static_cast<std::uint64_t>(std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0));
+
+			bump(buckets[bucket_of(value)]);
+			bump(total, value);
+			bump(count);
+
+			if (value > highest.load(std::memory_order_relaxed))
+				highest.store(value, std::memory_order_relaxed);
+		}
+
+		std::uint64_t samples() const
+		{
+			return count.load(std::memory_order_relaxed);
+		}
+
+		std::chrono::nanoseconds mean() const
+		{
+			const auto samples = count.load(std::memory_order_relaxed);
+			return std::chrono::nanoseconds(samples ? total.load(std::memory_order_relaxed) / samples : 0u);
+		}
+
+		std::chrono::nanoseconds max() const
+		{
+			return std::chrono::nanoseconds(highest.load(std::memory_order_relaxed));
+		}
+
+		// percentile is 0 - 100
+
+		std::chrono::nanoseconds percentile(double percentile) const
+		{
+			const auto samples = count.load(std::memory_order_relaxed);
+			if (!samples)
+				return std::chrono::nanoseconds::zero();
+
+			const auto wanted = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * samples + 0.5), 1u);
+
+			std::uint64_t seen{ 0u };
+			for (auto i = 0u; i < bucket_count; i++)
+			{
+				seen += buckets[i].load(std::memory_order_relaxed);
+				if (seen >= wanted)
+					return std::chrono::nanoseconds(std::min(bucket_ceiling(i), highest.load(std::memory_order_relaxed)));
+			}
+			return max();
+		}
+	};
+
+	namespace scheduler_types
+	{
+		struct task_profile_t
+		{
+			latency_histogram_t tick_time;
+			std::atomic<std::uint64_t> overruns{ 0u }; // Ticks that alone took longer than the frame budget
+		};
+	}
+
+	// Profiles are kept by task name so they survive the task & can still be dumped on exit
+
+	class task_profiler_t
+	{
+		using clock = std::chrono::steady_clock;
+
+		mutable std::mutex profiles_lock;
+		std::unordered_map<std::string, std::unique_ptr<scheduler_types::task_profile_t>> profiles;
+
+		scheduler_types::task_profile_t frames;
+	public:
+
+		// Only looks the name up once, when the task gets scheduled
+
+		scheduler_types::task_profile_t* profile_of(std::string_view name)
+		{
+			std::lock_guard guard(profiles_lock);
+
+			auto& profile = profiles[std::string(name)];
+			if (profile == nullptr)
+				profile = std::make_unique<scheduler_types::task_profile_t>();
+			return profile.get();
+		}
+
+		// Scheduler thread only, a budget of zero (uncapped) never counts as an overrun
+
+		void record(scheduler_types::task_profile_t* profile, clock::duration tick_time, clock::duration budget)
+		{
+			profile->tick_time.record(tick_time);
+
+			if (budget != clock::duration::zero() && tick_time > budget)
+				profile->overruns.store(profile->overruns.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+		}
+
+		void record_frame(clock::duration frame_time, clock::duration budget)
+		{
+			record(&frames, frame_time, budget);
+		}
+
+		const auto& frame_profile() const
+		{
+			return frames;
+		}
+
+		const scheduler_types::task_profile_t* find(std::string_view name) const
+		{
+			std::lock_guard guard(profiles_lock);
+
+			const auto found = profiles.find(std::string(name));
+			return found != profiles.end() ? found->second.get() : nullptr;
+		}
+
+		template<typename _Fn>
+		void for_each(_Fn&& callback) const
+		{
+			std::lock_guard guard(profiles_lock);
+
+			for (const auto& [name, profile] : profiles)
+				callback(std::string_view(name), *profile);
+		}
+
+		void dump() const
+		{
+			const auto line = [](std::string_view name, const scheduler_types::task_profile_t& profile) {
+				const auto& tick_time = profile.tick_time;
+				const auto micro = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1000.0; };
+
+				logger.log("%-24.*s ticks %8llu | mean %9.2fus | p50 %9.2fus | p99 %9.2fus | max %9.2fus | overruns %llu\n",
+					static_cast<int>(name.size()), name.data(),
+					static_cast<unsigned long long>(tick_time.samples()),
+					micro(tick_time.mean()), micro(tick_time.percentile(50.0)), micro(tick_time.percentile(99.0)), micro(tick_time.max()),
+					static_cast<unsigned long long>(profile.overruns.load(std::memory_order_relaxed)));
+			};
+
+			line("[frame]", frames);
+			for_each(line);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+/*
+*	Desc: Lock-free multi-producer single-consumer queue
+*	Note: Producers push onto an atomic list, the consumer takes the whole list in one exchange & flips it back into order,
+*	drained nodes are recycled instead of going back to the heap
+*/
+#pragma once
+#include <atomic>
+#include <utility>
+#include <optional>
+#include <cstdint>
+
+namespace zkelp
+{
+	template<typename _Ty>
+	class mpsc_queue_t
+	{
+		struct node_t
+		{
+			std::optional<_Ty> value;
+			node_t* next{ nullptr };
+		};
+
+		// Spare nodes per thread, shared by every queue of the same type
+
+		struct node_cache_t
+		{
+			node_t* head{ nullptr };
+
+			~node_cache_t()
+			{
+				while (head != nullptr)
+				{
+					const auto next = head->next;
+					delete head;
+					head = next;
+				}
+			}
+		};
+
+		static inline thread_local node_cache_t spares;
+
+		std::atomic<node_t*> head{ nullptr };
+
+		// Drained nodes go here, producers only ever take the whole list so no two threads can pop the same node
+
+		std::atomic<node_t*> recycled{ nullptr };
+
+		node_t* acquire()
+		{
+			auto& cache = spares;
+			if (cache.head == nullptr)
+				cache.head = recycled.exchange(nullptr, std::memory_order_acquire);
+
+			if (cache.head == nullptr)
+				return new node_t{};
+
+			const auto node = cache.head;
+			cache.head = node->next;
+			return node;
+		}
+	public:
+
+		mpsc_queue_t() = default;
+		mpsc_queue_t(const mpsc_queue_t&) = delete;
+		mpsc_queue_t& operator=(const mpsc_queue_t&) = delete;
+
+		~mpsc_queue_t()
+		{
+			drain([](_Ty&&) {});
+
+			auto node = recycled.exchange(nullptr, std::memory_order_acquire);
+			while (node != nullptr)
+			{
+				const auto next = node->next;
+				delete node;
+				node = next;
+			}
+		}
+
+		// Safe from any thread
+
+		void push(_Ty value)
+		{
+			auto node = acquire();
+			node->value.emplace(std::move(value));
+			node->next = head.load(std::memory_order_relaxed);
+
+			while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		bool empty() const
+		{
+			return head.load(std::memory_order_acquire) == nullptr;
+		}
+
+		// Consumer only, hands everything pushed so far to the callback in the order it was pushed
+
+		template<typename _Fn>
+		std::uint32_t drain(_Fn&& callback)
+		{
+			auto node = head.exchange(nullptr, std::memory_order_acquire);
+
+			// The list is newest first, flip it
+
+			node_t* ordered{ nullptr };
+			while (node != nullptr)
+			{
+				const auto next = node->next;
+				node->next = ordered;
+				ordered = node;
+				node = next;
+			}
+
+			if (ordered == nullptr)
+				return 0;
+
+			const auto first = ordered;
+			node_t* last{ nullptr };
+
+			auto count{ 0u };
+			while (ordered != nullptr)
+			{
+				callback(std::move(*ordered->value));
+				ordered->value.reset();
+
+				last = ordered;
+				ordered = ordered->next;
+				count++;
+			}
+
+			// Hand the whole run back in one go, it's still linked in order
+
+			last->next = recycled.load(std::memory_order_relaxed);
+			while (!recycled.compare_exchange_weak(last->next, first, std::memory_order_release, std::memory_order_relaxed));
+
+			return count;
+		}
+	};
+}
\ No newline at end of file
@@ -8,91 +8,544 @@
 #include <string_view>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 
+#include "tasks.hpp"
+#include "workers.hpp"
+#include "pacing.hpp"
+#include "graph.hpp"
+#include "queues.hpp"
+#include "slots.hpp"
+#include "frames.hpp"
+#include "profiling.hpp"
+#include "timers.hpp"
+#include "topology.hpp"
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#define SCHEDULER_TYPEID const std::type_info &type = typeid(*this)
 namespace zkelp 
 {
-	namespace scheduler_types 
+	class dynamic_scheduler_t
 	{
-		struct BaseTask 
+		struct task_command_t
 		{
-			std::string_view task_name{ "Unamed" };
-			std::optional<std::chrono::system_clock::duration> start_time;
-
-			virtual bool mainTick() { return false; };
+			scheduler_types::BaseTask* task{ nullptr };
+			bool remove{ false };
 		};
 
-		struct concurrentTask final : BaseTask
+		// Tasks only ever change on the scheduler thread, everyone else goes through the submission queue
+
+		slot_map_t<scheduler_types::BaseTask*> tasks;
+		slot_map_t<scheduler_types::BaseTask*> background_tasks;
+		mpsc_queue_t<task_command_t> submissions;
+		std::vector<scheduler_types::BaseTask*> finished_tasks;
+
+		std::unique_ptr<worker_pool_t> workers;
+		std::optional<std::jthread> singleton;
+
+		scheduler_types::affinity_settings_t affinity;
+		scheduler_types::affinity_plan_t affinity_plan;
+		GLFWwindow* renderingWindow{ nullptr };
+		bool headless{ false }; // No window at all, the renderer draws offscreen
+
+		frame_pacer_t pacer;
+		std::mutex pacing_lock;
+		std::optional<scheduler_types::frame_pacing_t> pending_pacing;
+
+		task_graph_t graph;
+		bool graph_dirty{ true };
+
+		std::mutex stats_lock;
+		scheduler_types::frame_stats_t last_frame;
+
+		task_profiler_t profiler;
+
+		std::mutex timers_lock;
+		timer_wheel_t timers;
+		std::vector<scheduler_types::fired_timer_t> due_timers;
+
+		std::condition_variable idle_wake;
+		std::atomic<bool> idle{ false };
+		std::atomic<bool> stopping{ false };
+
+		// Background phase
+
+		static constexpr auto idle_slice{ std::chrono::milliseconds(2) }; // Budget per round when there's no frame to pace against
+
+		std::vector<std::uint8_t> background_results;
+		std::vector<std::chrono::steady_clock::duration> background_times;
+		scheduler_types::job_group_t background_group;
+		scheduler_types::idle_stats_t idle_stats;
+
+		void drain_submissions()
 		{
-			std::function<void()> to_run;
+			submissions.drain([this](task_command_t&& command) {
+				const auto task = command.task;
 
-			SCHEDULER_TYPEID;
+				const auto background = task->priority == scheduler_types::task_priority::background;
+				auto& owner = background ? background_tasks : tasks;
+
+				if (command.remove)
+				{
+					const auto found = owner.find(task->scheduler_handle);
+					if (found != nullptr && *found == task)
+					{
+						owner.erase(task->scheduler_handle);
+						graph_dirty |= !background;
+						task->onRemoved();
+					}
+					return;
+				}
 
-			virtual bool mainTick() 
+				task->scheduler_handle = owner.insert(task);
+				task->profile = profiler.profile_of(task->task_name);
+				graph_dirty |= !background;
+			});
+		}
+
+		// Runs the task graph once, pinned tasks right here & the rest spread over the workers as their dependencies finish
+
+		void tick()
+		{
+			drain_submissions();
+
+			if (graph_dirty)
 			{
-				std::printf("%s -> run time : %f seconds\n", task_name.data(), start_time.has_value()  ? static_cast<std::float_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch() - start_time.value()).count()) / 1000.0f : 0);
-				to_run();
-				return true;
+				graph.rebuild(tasks.dense());
+				graph_dirty = false;
 			}
-		};  
-	}
 
-	class dynamic_scheduler_t
-	{
-		std::vector<scheduler_types::BaseTask*> tasks;
-		std::optional<std::jthread> singleton;
-		GLFWwindow* renderingWindow{ nullptr };
+			const auto frame_start = std::chrono::steady_clock::now();
+			const auto& results = graph.run(workers.get());
+
+			const auto budget = pacer.period();
+
+			{
+				std::lock_guard guard(stats_lock);
+				last_frame = graph.measure(frame_start);
+				profiler.record_frame(last_frame.frame_time, budget);
+			}
+
+			for (auto i = 0u; i < tasks.size(); i++)
+			{
+				auto& task = tasks[i];
+				profiler.record(task->profile, graph.tick_time(i), budget);
+
+				if (results[i])
+				{
+					if (!task->start_time.has_value())
+						task->start_time = std::make_optional(std::chrono::system_clock::now().time_since_epoch()); // Give time if the time isn't provided
+				}
+				else
+				{
+					finished_tasks.push_back(task);
+				}
+			}
+
+			// Drop finished tasks after the walk, erasing swaps values around
+
+			for (const auto task : finished_tasks)
+			{
+				tasks.erase(task->scheduler_handle);
+				task->onRemoved();
+			}
+
+			if (!finished_tasks.empty())
+			{
+				finished_tasks.clear();
+				graph_dirty = true;
+			}
+		}
+
+		// Hands the slack until the deadline to the background tasks, all of them start together & have to give up once it's expired
+		// The hard deadline is when the next frame starts, running past that is what counts as late
+
+		void run_background(std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::time_point hard_deadline)
+		{
+			using clock = std::chrono::steady_clock;
+
+			const auto start = clock::now();
+			const auto count = static_cast<std::uint32_t>(background_tasks.size());
+
+			if (!count || start >= deadline)
+				return;
+
+			const scheduler_types::idle_budget_t budget{ deadline };
+
+			background_results.assign(count, 1u);
+			background_times.assign(count, clock::duration::zero());
+
+			const auto run_one = [this, &budget](std::uint32_t i) {
+				if (budget.expired())
+					return; // Queued too long, it gets its turn next frame
+
+				const auto task_start = clock::now();
+				background_results[i] = background_tasks[i]->idleTick(budget);
+				background_times[i] = clock::now() - task_start;
+			};
+
+			const auto pinned = [this](std::uint32_t i) {
+				return workers == nullptr || background_tasks[i]->render_bound;
+			};
+
+			for (auto i = 0u; i < count; i++)
+				if (!pinned(i))
+					workers->submit([&run_one, i] { run_one(i); }, &background_group);
+
+			for (auto i = 0u; i < count; i++)
+				if (pinned(i))
+					run_one(i);
+
+			if (workers != nullptr)
+				workers->wait(background_group);
+
+			const auto end = clock::now();
+
+			{
+				std::lock_guard guard(stats_lock);
+				idle_stats.available += deadline - start;
+				idle_stats.used += end - start;
+				idle_stats.phases++;
+				idle_stats.late += end > hard_deadline;
+			}
+
+			for (auto i = 0u; i < count; i++)
+			{
+				if (background_times[i] != clock::duration::zero())
+					profiler.record(background_tasks[i]->profile, background_times[i], deadline - start);
+
+				if (!background_results[i])
+					finished_tasks.push_back(background_tasks[i]);
+			}
+
+			for (const auto task : finished_tasks)
+			{
+				background_tasks.erase(task->scheduler_handle);
+				task->onRemoved();
+			}
+			finished_tasks.clear();
+		}
+
+		// Slack left before the next frame, minus a guard so the pacer still starts the frame on time
+
+		void fill_slack()
+		{
+			const auto next = pacer.next_deadline();
+			if (!next.has_value())
+				return;
+
+			const auto guard = std::max<std::chrono::steady_clock::duration>(pacer.get_settings().spin_window, pacer.period() / 10);
+			run_background(next.value() - guard, next.value());
+		}
+
+		// Timer callbacks run here, on the scheduler thread & outside the lock so they can add or cancel timers themselves
+
+		void run_timers()
+		{
+			{
+				std::lock_guard guard(timers_lock);
+				timers.advance(std::chrono::steady_clock::now());
+				timers.take_fired(due_timers);
+			}
+
+			for (auto& timer : due_timers)
+			{
+				const auto keep = timer.callback();
+
+				std::lock_guard guard(timers_lock);
+				timers.finish(timer, keep);
+			}
+		}
+
+		// No tasks left, sleep until a timer is due, something gets submitted, stop is called or until passes
+
+		void wait_idle(std::chrono::steady_clock::time_point until = std::chrono::steady_clock::time_point::max())
+		{
+			std::unique_lock lock(timers_lock);
+
+			// Pairs with the fence in wake_idle, either we see the submission or it sees us idle
+
+			idle.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (submissions.empty() && !stopping.load(std::memory_order_acquire))
+			{
+				if (const auto due = timers.next_due())
+					until = std::min(until, due.value());
+
+				if (until == std::chrono::steady_clock::time_point::max())
+					idle_wake.wait(lock);
+				else
+					idle_wake.wait_until(lock, until);
+			}
+
+			idle.store(false, std::memory_order_relaxed);
+		}
+
+		void wake_idle()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (idle.load(std::memory_order_relaxed))
+			{
+				std::lock_guard guard(timers_lock);
+				idle_wake.notify_one();
+			}
+		}
+
+		void apply_pacing()
+		{
+			std::lock_guard guard(pacing_lock);
 
-		std::uint32_t run_timer{ 0u };
+			if (pending_pacing.has_value())
+			{
+				pacer.configure(pending_pacing.value());
+				pending_pacing.reset();
+			}
+		}
 	public:
 
-		void change_tick(const std::uint32_t& new_timer)
+		// Statics defined after us (the vulkan engine & its allocators) are already gone by now, so main has to join first
+
+		~dynamic_scheduler_t()
+		{
+			stop();
+			join();
+
+			if constexpr (utils::dumpTaskProfiles)
+			{
+				if (workers != nullptr)
+				{
+					profiler.dump();
+
+					const auto stats = get_idle_stats();
+					const auto available = std::chrono::duration<double, std::milli>(stats.available).count();
+					const auto used = std::chrono::duration<double, std::milli>(stats.used).count();
+
+					logger.log("[background] slack used %.2fms of %.2fms (%.1f%%) over %llu frames, %llu late\n", used, available, available > 0.0 ? used / available * 100.0 : 0.0,
+						static_cast<unsigned long long>(stats.phases), static_cast<unsigned long long>(stats.late));
+				}
+			}
+		}
+
+		// Takes effect on the next frame, safe to call from any thread
+
+		void change_pacing(const scheduler_types::frame_pacing_t& pacing)
 		{
-			run_timer = new_timer;
+			std::lock_guard guard(pacing_lock);
+			pending_pacing = pacing;
 		}
 
+		// Only read by run, so set it before that
+
+		void change_affinity(const scheduler_types::affinity_settings_t& settings)
+		{
+			affinity = settings;
+		}
+
+		const auto& get_affinity_plan() const
+		{
+			return affinity_plan;
+		}
+
+		// Same, run won't open a window (getRenderingWindow stays null)
+
+		void change_headless(bool enabled)
+		{
+			headless = enabled;
+		}
+
+		// Both are lock-free & safe from any thread, they take effect at the start of the next tick
+
 		void add_task(zkelp::scheduler_types::BaseTask* task) {
-			tasks.push_back(task);
+			submissions.push({ task, false });
+			wake_idle();
+		};
+
+		void remove_task(zkelp::scheduler_types::BaseTask* task) {
+			submissions.push({ task, true });
+			wake_idle();
 		};
 
+		// Timers, safe from any thread. Callbacks run on the scheduler thread, hand anything heavy to submit_job
+
+		scheduler_types::timer_handle_t add_timer(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::duration period, scheduler_types::timer_callback_t callback)
+		{
+			std::lock_guard guard(timers_lock);
+
+			const auto handle = timers.add(delay, period, std::move(callback));
+			idle_wake.notify_one(); // May be due before whatever the scheduler is sleeping on
+			return handle;
+		}
+
+		auto after(std::chrono::steady_clock::duration delay, std::function<void()> callback)
+		{
+			return add_timer(delay, {}, [callback = std::move(callback)] { callback(); return false; });
+		}
+
+		auto every(std::chrono::steady_clock::duration period, scheduler_types::timer_callback_t callback)
+		{
+			return add_timer(period, period, std::move(callback));
+		}
+
+		bool cancel_timer(scheduler_types::timer_handle_t handle)
+		{
+			std::lock_guard guard(timers_lock);
+			return timers.cancel(handle);
+		}
+
+		// Adds the task to the schedule once the delay passed
+
+		auto add_task_after(zkelp::scheduler_types::BaseTask* task, std::chrono::steady_clock::duration delay)
+		{
+			return after(delay, [this, task] { add_task(task); });
+		}
+
+		// Ticks the task once every period on the scheduler thread instead of every frame, until its mainTick returns false
+
+		auto tick_every(zkelp::scheduler_types::BaseTask* task, std::chrono::steady_clock::duration period)
+		{
+			return every(period, [task] { return task->mainTick(); });
+		}
+
+		// Timing of the last frame, including its critical path
+
+		auto get_frame_stats()
+		{
+			std::lock_guard guard(stats_lock);
+			return last_frame;
+		}
+
+		// Tick time histograms & budget overruns per task name, plus the whole frame under "[frame]"
+
+		const auto& get_profiler() const
+		{
+			return profiler;
+		}
+
+		// Slack the background tasks were given versus what they took, since the start
+
+		scheduler_types::idle_stats_t get_idle_stats()
+		{
+			std::lock_guard guard(stats_lock);
+			return idle_stats;
+		}
+
 		auto getRenderingWindow()
 		{
 			return renderingWindow;
 		}
 
-		bool run() 
+		// Sub-jobs, tasks can spread their own work over the workers with these
+
+		void submit_job(std::function<void()> to_run, scheduler_types::job_group_t* group = nullptr)
+		{
+			if (workers == nullptr)
+			{
+				to_run(); // Not running yet, so just do it here
+				return;
+			}
+			workers->submit(std::move(to_run), group);
+		}
+
+		void wait_jobs(scheduler_types::job_group_t& group)
+		{
+			if (workers != nullptr)
+				workers->wait(group);
+		}
+
+		auto get_workers()
+		{
+			return workers.get();
+		}
+
+		// The scheduler thread finishes the frame it's on & exits, safe from any thread (tasks & timer callbacks too). Idle, it
+		// otherwise sleeps until there's something to do again
+
+		void stop()
+		{
+			stopping.store(true, std::memory_order_release);
+
+			std::lock_guard guard(timers_lock);
+			idle_wake.notify_one();
+		}
+
+		// Blocks until the scheduler thread is done (after stop), call it before main returns so nothing the thread uses gets destroyed under it
+
+		void join()
+		{
+			if (singleton.has_value() && singleton->joinable() && singleton->get_id() != std::this_thread::get_id())
+				singleton->join();
+		}
+
+		bool run(std::uint32_t worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1u)
 		{
 			if (!singleton.has_value()) 
 			{
+				// Pinned, there's at most one worker per cpu the plan left for them
+
+				if (affinity.enabled)
+				{
+					const auto topology = topology::read_topology();
+					affinity_plan = topology::plan(topology, affinity);
+					topology::log_plan(topology, affinity_plan);
+
+					worker_count = std::min(worker_count, static_cast<std::uint32_t>(affinity_plan.worker_cpus.size()));
+				}
+
+				workers = std::make_unique<worker_pool_t>(worker_count, affinity_plan.worker_cpus);
+
 				// Make and set a singleton-running thread
 				singleton = std::make_optional(std::jthread([&] {
-					glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-					renderingWindow = glfwCreateWindow(800, 600, utils::applicationName, nullptr, nullptr);
+					if (affinity_plan.render_cpu.has_value() && !topology::pin_current_thread(affinity_plan.render_cpu.value()))
+						logger.log("topology | couldn't pin the render thread to cpu %u, it runs unpinned\n", affinity_plan.render_cpu.value());
 
-					while (true) 
+					if (!headless)
 					{
-						std::this_thread::sleep_for(std::chrono::milliseconds(run_timer)); // Prevent a crash
+						glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+						renderingWindow = glfwCreateWindow(800, 600, utils::applicationName, nullptr, nullptr);
+					}
 
-						// Loop through the tasks with their piorities listed
+					while (!stopping.load(std::memory_order_acquire))
+					{
+						apply_pacing();
+						run_timers();
 
-						for (auto i = 0u; i < tasks.size(); i++) 
-						{
-							auto& task = tasks[i];
+						// Nothing to tick, only background work & timers are left (or nothing at all, then we sleep till there is)
 
-							if (task->mainTick())
-							{
-								if (!task->start_time.has_value())
-									task->start_time = std::make_optional(std::chrono::system_clock::now().time_since_epoch()); // Give time if the time isn't provided
-							}
-							else
+						if (tasks.empty() && submissions.empty())
+						{
+							if (!background_tasks.empty())
 							{
-								tasks.erase(tasks.begin() + i);
+								// No frame to be late for. What the tasks leave of the slice is slept off, so giving up early doesn't spin us
+
+								const auto slice_end = std::chrono::steady_clock::now() + idle_slice;
+
+								run_background(slice_end, std::chrono::steady_clock::time_point::max());
+								wait_idle(slice_end);
+								continue;
 							}
+
+							wait_idle();
+							continue;
 						}
+
+						// Wait for the frame deadline, a late fixed timestep may owe a few ticks
+
+						const auto ticks = pacer.wait_next();
+
+						// Loop through the tasks with their piorities listed
+
+						for (auto i = 0u; i < ticks; i++)
+							tick();
+
+						// Whatever's left before the next frame goes to the background tasks
+
+						fill_slack();
 					}
 				}));
 			}
@@ -100,4 +553,8 @@ namespace zkelp
 		};
 	} dynamic_scheduler;
 
-}
\ No newline at end of file
+}
+
+// Coroutine tasks are built on dynamic_scheduler, so they come in once it's declared & everything that includes the scheduler gets them
+
+#include "coroutines.hpp"
\ No newline at end of file
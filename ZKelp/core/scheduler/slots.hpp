@@ -0,0 +1,132 @@
+/*
+*	Desc: Slot map with generation handles
+*	Note: Values stay packed for iteration, removing one swaps the last value into its place so nothing shifts
+*/
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		struct slot_handle_t
+		{
+			std::uint32_t index{ UINT32_MAX };
+			std::uint32_t generation{ 0u };
+
+			bool valid() const
+			{
+				return index != UINT32_MAX;
+			}
+		};
+	}
+
+	template<typename _Ty>
+	class slot_map_t
+	{
+		struct slot_t
+		{
+			std::uint32_t dense{ 0u };
+			std::uint32_t generation{ 0u };
+		};
+
+		std::vector<_Ty> values;
+		std::vector<std::uint32_t> owners; // Which slot every packed value belongs to
+		std::vector<slot_t> slots;
+		std::vector<std::uint32_t> free_slots;
+	public:
+
+		scheduler_types::slot_handle_t insert(_Ty value)
+		{
+			std::uint32_t index;
+
+			if (!free_slots.empty())
+			{
+				index = free_slots.back();
+				free_slots.pop_back();
+			}
+			else
+			{
+				index = static_cast<std::uint32_t>(slots.size());
+				slots.push_back({});
+			}
+
+			auto& slot = slots[index];
+			slot.dense = static_cast<std::uint32_t>(values.size());
+
+			values.push_back(std::move(value));
+			owners.push_back(index);
+
+			return { index, slot.generation };
+		}
+
+		bool contains(scheduler_types::slot_handle_t handle) const
+		{
+			return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+		}
+
+		_Ty* find(scheduler_types::slot_handle_t handle)
+		{
+			if (!contains(handle))
+				return nullptr;
+			return &values[slots[handle.index].dense];
+		}
+
+		// Stale handles are ignored, the slot's generation moves on so they stay stale
+
+		bool erase(scheduler_types::slot_handle_t handle)
+		{
+			if (!contains(handle))
+				return false;
+
+			auto& slot = slots[handle.index];
+			const auto hole = slot.dense;
+			const auto last = static_cast<std::uint32_t>(values.size()) - 1u;
+
+			if (hole != last)
+			{
+				values[hole] = std::move(values[last]);
+				owners[hole] = owners[last];
+				slots[owners[hole]].dense = hole;
+			}
+
+			values.pop_back();
+			owners.pop_back();
+
+			slot.generation++;
+			free_slots.push_back(handle.index);
+			return true;
+		}
+
+		auto size() const
+		{
+			return values.size();
+		}
+
+		bool empty() const
+		{
+			return values.empty();
+		}
+
+		auto& operator[](std::size_t dense)
+		{
+			return values[dense];
+		}
+
+		const auto& dense() const
+		{
+			return values;
+		}
+
+		auto begin()
+		{
+			return values.begin();
+		}
+
+		auto end()
+		{
+			return values.end();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+*	Desc: Scheduler tasks
+*	Note: Anything the dynamic scheduler ticks derives from BaseTask
+*/
+#pragma once
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <typeinfo>
+#include <functional>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+
+#include "slots.hpp"
+#include "profiling.hpp"
+
+#define SCHEDULER_TYPEID const std::type_info &type = typeid(*this)
+namespace zkelp 
+{
+	namespace scheduler_types 
+	{
+		enum class task_priority
+		{
+			frame,		// Ticks every frame as part of the task graph
+			background	// Only ticks in the slack left before the next frame, see idleTick
+		};
+
+		// How long a background tick may take, it has to check this itself & return once it's expired
+
+		struct idle_budget_t
+		{
+			std::chrono::steady_clock::time_point deadline;
+
+			bool expired() const
+			{
+				return std::chrono::steady_clock::now() >= deadline;
+			}
+
+			std::chrono::steady_clock::duration remaining() const
+			{
+				return std::max(deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+			}
+		};
+
+		struct idle_stats_t
+		{
+			std::chrono::steady_clock::duration available{};	// Slack handed to background tasks
+			std::chrono::steady_clock::duration used{};			// Time the background phase actually took
+			std::uint64_t phases{ 0u };							// Frames that had slack to give
+			std::uint64_t late{ 0u };							// Phases that ran past their deadline
+		};
+
+		struct BaseTask 
+		{
+			std::string_view task_name{ "Unamed" };
+			std::optional<std::chrono::system_clock::duration> start_time;
+
+			task_priority priority{ task_priority::frame };
+
+			// Pinned tasks always tick on the scheduler thread (it owns the window), the rest go to the workers
+			bool render_bound{ false };
+
+			// Tasks that have to finish their tick before this one starts (declare before adding the task)
+			std::vector<BaseTask*> depends_on;
+
+			void runAfter(BaseTask* task)
+			{
+				depends_on.push_back(task);
+			}
+
+			// Where the scheduler keeps this task, goes stale once it's removed
+			slot_handle_t scheduler_handle;
+
+			// Tick timings, the scheduler hooks this up when the task is added (query it through the scheduler's profiler)
+			task_profile_t* profile{ nullptr };
+
+			virtual bool mainTick() { return false; };
+
+			// Background ticks, yield once the budget runs out & keep the rest for next time (return false when done)
+			virtual bool idleTick([[maybe_unused]] const idle_budget_t& budget) { return mainTick(); };
+
+			// Called on the scheduler thread once the task is out of the schedule, the scheduler won't touch it again
+			virtual void onRemoved() {};
+		};
+
+		struct concurrentTask final : BaseTask
+		{
+			std::function<void()> to_run;
+
+			SCHEDULER_TYPEID;
+
+			virtual bool mainTick() 
+			{
+				to_run();
+				return true;
+			}
+		};  
+	}
+}
\ No newline at end of file
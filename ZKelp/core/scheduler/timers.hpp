@@ -0,0 +1,326 @@
+/*
+*	Desc: Hierarchical timer wheel
+*	Note: 4 levels of 64 slots at 1ms, timers drop a level as they get close so adding & cancelling stays O(1)
+*/
+#pragma once
+#include <array>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include "slots.hpp"
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		using timer_handle_t = slot_handle_t;
+
+		// Return false to stop a periodic timer, one-shots ignore it
+		using timer_callback_t = std::function<bool()>;
+
+		struct fired_timer_t
+		{
+			timer_handle_t handle;
+			timer_callback_t callback;
+		};
+	}
+
+	// Not thread safe, the scheduler guards it
+
+	class timer_wheel_t
+	{
+		using clock = std::chrono::steady_clock;
+
+		static constexpr std::uint32_t slot_bits{ 6u };
+		static constexpr std::uint32_t slot_count{ 1u << slot_bits };
+		static constexpr std::uint32_t level_count{ 4u };
+		static constexpr std::uint64_t wheel_span{ 1ull << (slot_bits * level_count) }; // ~4.6 hours, anything further waits in the top level & gets re-placed
+		static constexpr std::uint32_t none{ UINT32_MAX };
+
+		struct timer_node_t
+		{
+			std::uint64_t expires{ 0u };	// In wheel ticks
+			std::uint64_t period{ 0u };		// 0 for one-shots
+			scheduler_types::timer_callback_t callback;
+
+			std::uint32_t previous{ none };
+			std::uint32_t next{ none };
+			std::uint32_t generation{ 0u };
+			std::uint32_t* head{ nullptr }; // Slot it's linked into, nothing when it's free
+		};
+
+		clock::time_point origin{ clock::now() };
+		std::uint64_t current{ 0u };
+		std::uint32_t active{ 0u };
+
+		std::array<std::array<std::uint32_t, slot_count>, level_count> slots;
+		std::vector<timer_node_t> nodes;
+		std::vector<std::uint32_t> free_nodes;
+		std::vector<scheduler_types::fired_timer_t> fired;
+
+		std::uint64_t ticks_at(clock::time_point time) const
+		{
+			if (time <= origin)
+				return 0u;
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - origin).count());
+		}
+
+		static std::uint64_t ticks_of(clock::duration duration)
+		{
+			// Round up, a timer never fires early
+
+			const auto milliseconds = std::chrono::ceil<std::chrono::milliseconds>(duration).count();
+			return static_cast<std::uint64_t>(std::max<std::int64_t>(milliseconds, 0));
+		}
+
+		// Due timers only go in the current slot while it's being walked, otherwise it was already walked & they'd wait a whole turn
+
+		void link(std::uint32_t index, bool walking = false)
+		{
+			auto& node = nodes[index];
+
+			const auto expires = std::max(node.expires, walking ? current : current + 1u);
+			const auto delta = std::min(expires - current, wheel_span - 1u);
+			const auto target = current + delta;
+
+			auto level = 0u;
+			while (level + 1u < level_count && delta >= (1ull << (slot_bits * (level + 1u))))
+				level++;
+
+			auto& head = slots[level][(target >> (slot_bits * level)) & (slot_count - 1u)];
+
+			node.previous = none;
+			node.next = head;
+			node.head = &head;
+
+			if (head != none)
+				nodes[head].previous = index;
+			head = index;
+		}
+
+		void unlink(std::uint32_t index)
+		{
+			auto& node = nodes[index];
+
+			if (node.previous != none)
+				nodes[node.previous].next = node.next;
+			else
+				*node.head = node.next;
+
+			if (node.next != none)
+				nodes[node.next].previous = node.previous;
+
+			node.previous = none;
+			node.next = none;
+			node.head = nullptr;
+		}
+
+		void release(std::uint32_t index)
+		{
+			auto& node = nodes[index];
+			node.callback = nullptr;
+			node.generation++;
+
+			free_nodes.push_back(index);
+			active--;
+		}
+
+		// Moves a higher level slot down now that its timers are within reach
+
+		void cascade(std::uint32_t level)
+		{
+			auto& head = slots[level][(current >> (slot_bits * level)) & (slot_count - 1u)];
+
+			auto index = head;
+			head = none;
+
+			while (index != none)
+			{
+				const auto next = nodes[index].next;
+				nodes[index].head = nullptr;
+				link(index, true);
+				index = next;
+			}
+		}
+
+		void expire()
+		{
+			auto& head = slots[0][current & (slot_count - 1u)];
+
+			while (head != none)
+			{
+				const auto index = head;
+				unlink(index);
+
+				auto& node = nodes[index];
+
+				if (node.expires > current)
+				{
+					link(index); // Was parked at the far end of the wheel, still not due
+					continue;
+				}
+
+				// A periodic callback that's still out running just skips this one
+
+				if (node.callback)
+					fired.push_back({ { index, node.generation }, std::move(node.callback) });
+
+				if (node.period)
+				{
+					node.expires = std::max(node.expires + node.period, current + 1u);
+					link(index);
+				}
+				else
+				{
+					release(index);
+				}
+			}
+		}
+	public:
+
+		timer_wheel_t()
+		{
+			for (auto& level : slots)
+				level.fill(none);
+		}
+
+		scheduler_types::timer_handle_t add(clock::duration delay, clock::duration period, scheduler_types::timer_callback_t callback)
+		{
+			std::uint32_t index;
+
+			if (!free_nodes.empty())
+			{
+				index = free_nodes.back();
+				free_nodes.pop_back();
+			}
+			else
+			{
+				index = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+			}
+
+			// Counted from the real time, the wheel itself may be a little behind if nothing advanced it lately
+
+			auto& node = nodes[index];
+			node.expires = std::max(ticks_at(clock::now()), current) + std::max<std::uint64_t>(ticks_of(delay), 1u);
+			node.period = period > clock::duration::zero() ? std::max<std::uint64_t>(ticks_of(period), 1u) : 0u;
+			node.callback = std::move(callback);
+
+			link(index);
+			active++;
+
+			return { index, node.generation };
+		}
+
+		bool cancel(scheduler_types::timer_handle_t handle)
+		{
+			if (handle.index >= nodes.size() || nodes[handle.index].generation != handle.generation)
+				return false;
+
+			// Fired one-shots are already gone, periodic ones that are mid-callback just aren't linked
+
+			if (nodes[handle.index].head != nullptr)
+				unlink(handle.index);
+
+			release(handle.index);
+			return true;
+		}
+
+		bool empty() const
+		{
+			return !active;
+		}
+
+		// Walks the wheel up to now, due callbacks are collected for take_fired (run them without holding whatever guards the wheel)
+
+		void advance(clock::time_point now)
+		{
+			const auto target = ticks_at(now);
+
+			if (!active)
+			{
+				current = std::max(current, target);
+				return;
+			}
+
+			while (current < target)
+			{
+				current++;
+
+				// Going past a slot boundary pulls the next slot of the level above down
+
+				for (auto level = 1u; level < level_count; level++)
+				{
+					if (current & ((1ull << (slot_bits * level)) - 1u))
+						break;
+					cascade(level);
+				}
+
+				expire();
+
+				if (!active)
+				{
+					current = target;
+					break;
+				}
+			}
+		}
+
+		void take_fired(std::vector<scheduler_types::fired_timer_t>& out)
+		{
+			out.clear();
+			out.swap(fired);
+		}
+
+		// A periodic callback comes back here once it ran, unless it was cancelled meanwhile or asked to stop
+
+		void finish(scheduler_types::fired_timer_t& timer, bool keep)
+		{
+			const auto index = timer.handle.index;
+			if (nodes[index].generation != timer.handle.generation)
+				return;
+
+			if (!keep)
+			{
+				cancel(timer.handle);
+				return;
+			}
+			nodes[index].callback = std::move(timer.callback);
+		}
+
+		// Earliest a timer can be due, it can be a bit early for timers that are still on a higher level
+
+		std::optional<clock::time_point> next_due() const
+		{
+			if (!active)
+				return {};
+
+			std::optional<std::uint64_t> earliest;
+
+			for (auto level = 0u; level < level_count; level++)
+			{
+				const auto shift = slot_bits * level;
+
+				for (auto i = 1u; i <= slot_count; i++)
+				{
+					const auto slot = ((current >> shift) + i) & (slot_count - 1u);
+					if (slots[level][slot] == none)
+						continue;
+
+					const auto start = std::max(((current >> shift) + i) << shift, current + 1u);
+					if (!earliest.has_value() || start < earliest.value())
+						earliest = start;
+					break;
+				}
+			}
+
+			if (!earliest.has_value())
+				return {};
+			return origin + std::chrono::milliseconds(earliest.value());
+		}
+	};
+}
\ No newline at end of file
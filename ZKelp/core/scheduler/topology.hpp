@@ -0,0 +1,333 @@
+/*
+*	Desc: CPU topology & thread affinity
+*	Note: Figures out which logical CPUs share a physical core, so the render thread & workers each get a core of their own
+*/
+#pragma once
+#include <map>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../../utilities/console/logger.hpp"
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		struct logical_cpu_t
+		{
+			std::uint32_t id{ 0u };			// What the OS calls it, used for pinning
+			std::uint32_t core{ 0u };		// Index into cpu_topology_t::cores
+			std::uint32_t package{ 0u };
+		};
+
+		struct cpu_topology_t
+		{
+			std::vector<logical_cpu_t> cpus;
+			std::vector<std::vector<std::uint32_t>> cores; // Logical CPU ids of every physical core, SMT siblings share one
+		};
+
+		struct affinity_settings_t
+		{
+			bool enabled{ false };
+			std::uint32_t reserved_cores{ 1u };	// Physical cores left to the OS (interrupts & the like), taken from the start
+			bool use_smt_siblings{ false };		// Let workers onto the second thread of a core once every core has one
+		};
+
+		struct affinity_plan_t
+		{
+			std::optional<std::uint32_t> render_cpu;
+			std::vector<std::uint32_t> worker_cpus;
+		};
+	}
+
+	namespace topology
+	{
+#ifndef _WIN32
+		// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+
+		static std::vector<std::uint32_t> parse_cpu_list(const std::string& list)
+		{
+			std::vector<std::uint32_t> cpus;
+
+			std::size_t position{ 0u };
+			while (position < list.size())
+			{
+				auto end = list.find(',', position);
+				if (end == std::string::npos)
+					end = list.size();
+
+				const auto range = list.substr(position, end - position);
+				const auto dash = range.find('-');
+
+				try
+				{
+					const auto first = static_cast<std::uint32_t>(std::stoul(range.substr(0u, dash)));
+					const auto last = dash == std::string::npos ? first : static_cast<std::uint32_t>(std::stoul(range.substr(dash + 1u)));
+
+					for (auto cpu = first; cpu <= last; cpu++)
+						cpus.push_back(cpu);
+				}
+				catch (...) {} // Trailing newline & such
+
+				position = end + 1u;
+			}
+			return cpus;
+		}
+
+		static std::optional<std::string> read_sysfs(const std::string& path)
+		{
+			std::ifstream file(path);
+			if (!file.is_open())
+				return {};
+
+			std::string contents;
+			std::getline(file, contents);
+			return contents;
+		}
+#endif
+
+		// Logical CPUs the process may run on (taskset, a cgroup cpuset, a container's limit), empty when the OS won't say. Read once
+		// before anything gets pinned, sched_getaffinity only sees the calling thread's mask
+
+		static const std::vector<std::uint32_t>& allowed_cpus()
+		{
+			static const auto allowed = [] {
+				std::vector<std::uint32_t> cpus;
+
+#ifdef _WIN32
+				DWORD_PTR process_mask{ 0u }, system_mask{ 0u };
+				if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+					for (auto bit = 0u; bit < sizeof(DWORD_PTR) * 8u; bit++)
+						if (process_mask & (static_cast<DWORD_PTR>(1u) << bit))
+							cpus.push_back(bit);
+#else
+				cpu_set_t set;
+				CPU_ZERO(&set);
+
+				if (sched_getaffinity(0, sizeof(set), &set) == 0)
+					for (auto cpu = 0u; cpu < CPU_SETSIZE; cpu++)
+						if (CPU_ISSET(cpu, &set))
+							cpus.push_back(cpu);
+#endif
+				return cpus;
+			}();
+
+			return allowed;
+		}
+
+		static bool is_allowed(std::uint32_t cpu)
+		{
+			const auto& allowed = allowed_cpus();
+			return allowed.empty() || std::binary_search(allowed.begin(), allowed.end(), cpu);
+		}
+
+		// Every logical CPU gets its own core when the OS won't tell us any better
+
+		static scheduler_types::cpu_topology_t flat_topology()
+		{
+			scheduler_types::cpu_topology_t topology;
+
+			auto cpus = allowed_cpus();
+			if (cpus.empty())
+				for (auto i = 0u; i < std::max(std::thread::hardware_concurrency(), 1u); i++)
+					cpus.push_back(i);
+
+			for (const auto cpu : cpus)
+			{
+				const auto core = static_cast<std::uint32_t>(topology.cores.size());
+				topology.cpus.push_back({ cpu, core, 0u });
+				topology.cores.push_back({ cpu });
+			}
+			return topology;
+		}
+
+		static scheduler_types::cpu_topology_t read_topology()
+		{
+			scheduler_types::cpu_topology_t topology;
+
+#ifdef _WIN32
+			DWORD length{ 0u };
+			GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+
+			std::vector<std::uint8_t> buffer(length);
+			const auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data());
+
+			if (!length || !GetLogicalProcessorInformationEx(RelationProcessorCore, info, &length))
+				return flat_topology();
+
+			// Only the first processor group, SetThreadAffinityMask can't reach past it anyway
+
+			for (DWORD offset = 0u; offset < length;)
+			{
+				const auto entry = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset);
+				const auto mask = entry->Processor.GroupMask[0].Group == 0u ? entry->Processor.GroupMask[0].Mask : 0u;
+
+				std::vector<std::uint32_t> siblings;
+				for (auto bit = 0u; bit < sizeof(KAFFINITY) * 8u; bit++)
+					if ((mask & (static_cast<KAFFINITY>(1u) << bit)) && is_allowed(bit))
+						siblings.push_back(bit);
+
+				if (!siblings.empty())
+				{
+					const auto core = static_cast<std::uint32_t>(topology.cores.size());
+					for (const auto cpu : siblings)
+						topology.cpus.push_back({ cpu, core, 0u });
+					topology.cores.push_back(std::move(siblings));
+				}
+
+				offset += entry->Size;
+			}
+#else
+			const auto online = read_sysfs("/sys/devices/system/cpu/online");
+			if (!online.has_value())
+				return flat_topology();
+
+			// Cores are only unique within their package. CPUs the process isn't allowed on are left out, pinning to them fails
+
+			std::map<std::pair<std::int64_t, std::int64_t>, std::uint32_t> core_index;
+
+			for (const auto cpu : parse_cpu_list(online.value()))
+			{
+				if (!is_allowed(cpu))
+					continue;
+
+				const auto base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+				const auto core_id = read_sysfs(base + "core_id");
+				const auto package_id = read_sysfs(base + "physical_package_id");
+
+				std::pair<std::int64_t, std::int64_t> key{ -1, cpu };
+				try
+				{
+					if (core_id.has_value() && package_id.has_value())
+						key = { std::stoll(package_id.value()), std::stoll(core_id.value()) };
+				}
+				catch (...) {}
+
+				auto found = core_index.find(key);
+				if (found == core_index.end())
+				{
+					found = core_index.emplace(key, static_cast<std::uint32_t>(topology.cores.size())).first;
+					topology.cores.push_back({});
+				}
+
+				topology.cpus.push_back({ cpu, found->second, static_cast<std::uint32_t>(std::max<std::int64_t>(key.first, 0)) });
+				topology.cores[found->second].push_back(cpu);
+			}
+#endif
+
+			if (topology.cpus.empty())
+				return flat_topology();
+			return topology;
+		}
+
+		// Render thread gets the first core past the reserved ones to itself (its sibling stays idle), workers get one core each after that
+
+		static scheduler_types::affinity_plan_t plan(const scheduler_types::cpu_topology_t& topology, const scheduler_types::affinity_settings_t& settings)
+		{
+			scheduler_types::affinity_plan_t plan;
+
+			const auto core_count = static_cast<std::uint32_t>(topology.cores.size());
+
+			// Never reserve so much that the render thread & one worker have nowhere to go
+
+			const auto reserved = std::min(settings.reserved_cores, core_count > 2u ? core_count - 2u : 0u);
+
+			if (reserved >= core_count)
+				return plan;
+
+			plan.render_cpu = topology.cores[reserved].front();
+
+			for (auto core = reserved + 1u; core < core_count; core++)
+				plan.worker_cpus.push_back(topology.cores[core].front());
+
+			if (settings.use_smt_siblings)
+				for (auto core = reserved + 1u; core < core_count; core++)
+					for (auto sibling = 1u; sibling < topology.cores[core].size(); sibling++)
+						plan.worker_cpus.push_back(topology.cores[core][sibling]);
+
+			// A single core machine, everyone shares the render core
+
+			if (plan.worker_cpus.empty())
+				plan.worker_cpus.push_back(plan.render_cpu.value());
+
+			return plan;
+		}
+
+		static bool pin_current_thread(std::uint32_t cpu)
+		{
+#ifdef _WIN32
+			if (cpu >= sizeof(DWORD_PTR) * 8u)
+				return false;
+			return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1u) << cpu) != 0u;
+#else
+			if (cpu >= CPU_SETSIZE)
+				return false;
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+		}
+
+		// Back to running anywhere the process may
+
+		static bool unpin_current_thread()
+		{
+#ifdef _WIN32
+			DWORD_PTR process_mask{ 0u }, system_mask{ 0u };
+			if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+				return false;
+			return SetThreadAffinityMask(GetCurrentThread(), process_mask) != 0u;
+#else
+			// What the process was allowed before anything got pinned, every online CPU when we couldn't tell
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+
+			const auto online = read_sysfs("/sys/devices/system/cpu/online");
+			if (!allowed_cpus().empty())
+			{
+				for (const auto cpu : allowed_cpus())
+					CPU_SET(cpu, &set);
+			}
+			else if (online.has_value())
+			{
+				for (const auto cpu : parse_cpu_list(online.value()))
+					if (cpu < CPU_SETSIZE)
+						CPU_SET(cpu, &set);
+			}
+			else
+			{
+				for (auto cpu = 0u; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++)
+					CPU_SET(cpu, &set);
+			}
+
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+		}
+
+		static void log_plan(const scheduler_types::cpu_topology_t& topology, const scheduler_types::affinity_plan_t& plan)
+		{
+			std::string workers;
+			for (const auto cpu : plan.worker_cpus)
+				workers += std::to_string(cpu) + " ";
+
+			logger.log("topology | %zu logical cpus on %zu cores, render thread on cpu %d, workers on %s\n", topology.cpus.size(), topology.cores.size(),
+				plan.render_cpu.has_value() ? static_cast<int>(plan.render_cpu.value()) : -1, workers.c_str());
+		}
+	}
+}
\ No newline at end of file
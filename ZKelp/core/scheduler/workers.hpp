@@ -0,0 +1,230 @@
+/*
+*	Desc: Work-stealing worker pool
+*	Note: Every worker owns a deque, it pops its own work from the back & steals from the front of the others
+*/
+#pragma once
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+#include "topology.hpp"
+
+namespace zkelp
+{
+	namespace scheduler_types
+	{
+		// Tracks a batch of jobs, so whoever submitted them can wait until they're all done
+
+		struct job_group_t
+		{
+			std::atomic<std::uint32_t> pending{ 0u };
+
+			bool done() const
+			{
+				return pending.load(std::memory_order_acquire) == 0u;
+			}
+		};
+
+		struct job_t
+		{
+			std::function<void()> to_run;
+			job_group_t* group{ nullptr };
+		};
+	}
+
+	class worker_pool_t
+	{
+		struct worker_queue_t
+		{
+			std::mutex lock;
+			std::deque<scheduler_types::job_t> jobs;
+		};
+
+		// One queue per worker, plus a last one for threads that aren't part of the pool (e.g. the render thread)
+
+		std::vector<std::unique_ptr<worker_queue_t>> queues;
+		std::vector<std::jthread> workers;
+
+		std::atomic<std::uint32_t> signal{ 0u };
+		std::atomic<bool> stopping{ false };
+
+		static inline thread_local worker_pool_t* local_pool{ nullptr };
+		static inline thread_local std::uint32_t local_index{ 0u };
+
+		auto injection_queue()
+		{
+			return queues.back().get();
+		}
+
+		std::optional<scheduler_types::job_t> pop_back(worker_queue_t* queue)
+		{
+			std::lock_guard guard(queue->lock);
+			if (queue->jobs.empty())
+				return {};
+
+			auto job = std::move(queue->jobs.back());
+			queue->jobs.pop_back();
+			return job;
+		}
+
+		std::optional<scheduler_types::job_t> pop_front(worker_queue_t* queue)
+		{
+			std::lock_guard guard(queue->lock);
+			if (queue->jobs.empty())
+				return {};
+
+			auto job = std::move(queue->jobs.front());
+			queue->jobs.pop_front();
+			return job;
+		}
+
+		// Own deque first (LIFO, it's still hot in cache), then outside submissions, then steal from a neighbour (FIFO)
+
+		std::optional<scheduler_types::job_t> find_job()
+		{
+			const auto owned = local_pool == this;
+
+			if (owned)
+				if (auto job = pop_back(queues[local_index].get()))
+					return job;
+
+			if (auto job = pop_front(injection_queue()))
+				return job;
+
+			const auto count = static_cast<std::uint32_t>(queues.size()) - 1u; // Workers may still be spawning, the queues are all there
+			const auto start = owned ? local_index + 1 : 0u;
+
+			for (auto i = 0u; i < count; i++)
+			{
+				const auto victim = (start + i) % count;
+				if (owned && victim == local_index)
+					continue;
+
+				if (auto job = pop_front(queues[victim].get()))
+					return job;
+			}
+			return {};
+		}
+
+		void execute(scheduler_types::job_t& job)
+		{
+			job.to_run();
+
+			if (job.group != nullptr && job.group->pending.fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+				job.group->pending.notify_all();
+		}
+
+		void worker_main(std::uint32_t index, std::optional<std::uint32_t> cpu)
+		{
+			local_pool = this;
+			local_index = index;
+
+			if (cpu.has_value() && !topology::pin_current_thread(cpu.value()))
+				logger.log("topology | couldn't pin worker %u to cpu %u, it runs unpinned\n", index, cpu.value());
+
+			while (!stopping.load(std::memory_order_acquire))
+			{
+				// Read the signal before looking, so a submission in between wakes us right back up
+
+				const auto seen = signal.load(std::memory_order_acquire);
+
+				if (auto job = find_job())
+				{
+					execute(job.value());
+					continue;
+				}
+
+				signal.wait(seen, std::memory_order_acquire);
+			}
+		}
+	public:
+
+		// Worker i gets pinned to cpus[i] when there are cpus given, it wraps around if there's more workers than cpus
+
+		explicit worker_pool_t(std::uint32_t worker_count, const std::vector<std::uint32_t>& cpus = {})
+		{
+			worker_count = std::max(worker_count, 1u);
+
+			for (auto i = 0u; i <= worker_count; i++)
+				queues.push_back(std::make_unique<worker_queue_t>());
+
+			workers.reserve(worker_count);
+			for (auto i = 0u; i < worker_count; i++)
+			{
+				const auto cpu = cpus.empty() ? std::nullopt : std::make_optional(cpus[i % cpus.size()]);
+				workers.emplace_back([this, i, cpu] { worker_main(i, cpu); });
+			}
+		}
+
+		~worker_pool_t()
+		{
+			stopping.store(true, std::memory_order_release);
+			signal.fetch_add(1u, std::memory_order_release);
+			signal.notify_all();
+
+			workers.clear(); // Joins
+		}
+
+		worker_pool_t(const worker_pool_t&) = delete;
+		worker_pool_t& operator=(const worker_pool_t&) = delete;
+
+		auto worker_count() const
+		{
+			return static_cast<std::uint32_t>(workers.size());
+		}
+
+		// Is the calling thread one of ours
+
+		bool in_worker() const
+		{
+			return local_pool == this;
+		}
+
+		void submit(std::function<void()> to_run, scheduler_types::job_group_t* group = nullptr)
+		{
+			if (group != nullptr)
+				group->pending.fetch_add(1u, std::memory_order_relaxed);
+
+			// Jobs spawned from a worker stay on its deque, everyone else goes through the shared one
+
+			const auto queue = in_worker() ? queues[local_index].get() : injection_queue();
+			{
+				std::lock_guard guard(queue->lock);
+				queue->jobs.push_back({ std::move(to_run), group });
+			}
+
+			signal.fetch_add(1u, std::memory_order_release);
+			signal.notify_one();
+		}
+
+		// Blocks until the group is done, helping out with queued jobs meanwhile unless told not to
+
+		void wait(scheduler_types::job_group_t& group, bool help = true)
+		{
+			while (!group.done())
+			{
+				if (help)
+				{
+					// Never block here, the jobs we wait on could land on a deque only we'd look at
+
+					if (auto job = find_job())
+						execute(job.value());
+					else
+						std::this_thread::yield();
+					continue;
+				}
+
+				const auto pending = group.pending.load(std::memory_order_acquire);
+				if (pending != 0u)
+					group.pending.wait(pending, std::memory_order_acquire);
+			}
+		}
+	};
+}
\ No newline at end of file
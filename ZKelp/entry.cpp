@@ -15,20 +15,79 @@
 #include "core/scheduler/scheduler.hpp"
 #include "core/rendering/rendering.hpp"
 
-int main() {
+#include "benchmarks/benchmarks.hpp"
+#include "tools/convert.hpp"
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
 	SetConsoleTitleA(utils::applicationName);
+#endif
 	logger.log("Welcome to Zkelp\n");
 
+	// "--headless" draws offscreen without a window, "--frames N" does too & sets how many frames before it quits.
+	// Options are read first so benchmarks & conversion get them too, anything that isn't one is an argument to the mode
+
+	std::optional<std::uint32_t> headlessFrames;
+	std::vector<std::string> arguments;
+
+	for (auto i = 1; i < argc; i++)
+	{
+		const auto argument = std::string_view(argv[i]);
+
+		if (argument == "--headless" && !headlessFrames.has_value())
+			headlessFrames = 300u;
+		else if (argument == "--frames" && i + 1 < argc)
+			headlessFrames = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--resources" && i + 1 < argc)
+			utils::resourcesPath = argv[++i];
+		else if (argument == "--in-flight" && i + 1 < argc)
+			utils::framesInFlight = std::max(static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1u);
+		else if (argument == "--precomputed-mips")
+			utils::precomputedMips = true;
+		else
+			arguments.emplace_back(argument);
+	}
+
+	// Benchmarks run instead of the engine
+
+	if (arguments.size() > 1 && arguments[0] == "--bench")
+	{
+		try
+		{
+			if (!benchmarks::run(arguments[1]))
+				logger.log("Unknown benchmark \"%s\"\n", arguments[1].c_str());
+		} catch (err::err& err) {
+			logger.log(err.what().c_str());
+		} catch (std::exception& error) {
+			logger.log("%s\n", error.what());
+		}
+		return 0;
+	}
+
+	// "--convert a.png b.png ..." writes a BC7 .ktx2 next to each one & quits
+
+	if (arguments.size() > 1 && arguments[0] == "--convert")
+	{
+		if (!tools::convertTextures(std::vector<std::string>(arguments.begin() + 1, arguments.end())))
+			logger.log("Some textures failed to convert\n");
+		return 0;
+	}
+
 	zkelp::scheduler_types::RenderingTask* rendererTask{ nullptr };
 
 	try
 	{
 		logger.log("Starting up renderer...\n");
-		rendererTask = zkelp::initRenderer();
+
+		if (headlessFrames.has_value())
+			zkelp::initHeadlessRenderer(headlessFrames.value());
+		else
+			rendererTask = zkelp::initRenderer();
 
 		//std::atexit(gnr::cify([renderingTask]() { renderingTask->cleanScene(); }));
 
 		zkelp::dynamic_scheduler.run();
+		zkelp::dynamic_scheduler.join();
 	} catch (err::err& err) {
 		logger.log(err.what().c_str());
 
@@ -0,0 +1,278 @@
+/*
+*	Desc: BC7 encoder
+*	Note: Mode 6 only (one subset, RGBA endpoints, 4 bit indices), endpoints come off the block's principal axis & get one least squares refit
+*/
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+
+namespace tools
+{
+	namespace bc7
+	{
+		constexpr std::uint32_t weights[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Mode 6 endpoints, 7 bits a channel plus a p-bit shared by the four
+
+		struct Endpoint
+		{
+			std::uint8_t channels[4]{};
+			std::uint8_t pbit{ 0u };
+
+			std::uint32_t value(std::uint32_t channel) const
+			{
+				return (static_cast<std::uint32_t>(channels[channel]) << 1u) | pbit;
+			}
+		};
+
+		// Blocks are written least significant bit first
+
+		struct BlockWriter
+		{
+			std::uint8_t* out;
+			std::uint32_t position{ 0u };
+
+			void write(std::uint32_t value, std::uint32_t bits)
+			{
+				for (auto bit = 0u; bit < bits; bit++, position++)
+					if ((value >> bit) & 1u)
+						out[position / 8u] |= static_cast<std::uint8_t>(1u << (position % 8u));
+			}
+		};
+
+		static Endpoint quantize(const float color[4])
+		{
+			Endpoint best;
+			auto bestError{ INFINITY };
+
+			for (auto pbit = 0u; pbit < 2u; pbit++)
+			{
+				Endpoint endpoint;
+				endpoint.pbit = static_cast<std::uint8_t>(pbit);
+
+				auto error{ 0.0f };
+				for (auto channel = 0u; channel < 4u; channel++)
+				{
+					const auto quantized = std::clamp(static_cast<int>(std::lround((color[channel] - static_cast<float>(pbit)) / 2.0f)), 0, 127);
+					endpoint.channels[channel] = static_cast<std::uint8_t>(quantized);
+
+					const auto difference = static_cast<float>(endpoint.value(channel)) - color[channel];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					best = endpoint;
+				}
+			}
+
+			return best;
+		}
+
+		// Each texel takes the closest of the 16 palette entries, returns the block's squared error
+
+		static std::uint32_t assign(const std::uint8_t pixels[16][4], const Endpoint& low, const Endpoint& high, std::uint8_t indices[16])
+		{
+			std::uint32_t palette[16][4];
+			for (auto index = 0u; index < 16u; index++)
+				for (auto channel = 0u; channel < 4u; channel++)
+					palette[index][channel] = (low.value(channel) * (64u - weights[index]) + high.value(channel) * weights[index] + 32u) >> 6u;
+
+			std::uint32_t total{ 0u };
+
+			for (auto texel = 0u; texel < 16u; texel++)
+			{
+				auto bestError{ UINT32_MAX };
+
+				for (auto index = 0u; index < 16u; index++)
+				{
+					std::uint32_t error{ 0u };
+					for (auto channel = 0u; channel < 4u; channel++)
+					{
+						const auto difference = static_cast<int>(palette[index][channel]) - static_cast<int>(pixels[texel][channel]);
+						error += static_cast<std::uint32_t>(difference * difference);
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						indices[texel] = static_cast<std::uint8_t>(index);
+					}
+				}
+
+				total += bestError;
+			}
+
+			return total;
+		}
+
+		// Endpoints that fit the texels best for the indices they got (least squares on each channel)
+
+		static bool refit(const std::uint8_t pixels[16][4], const std::uint8_t indices[16], float low[4], float high[4])
+		{
+			float aa{ 0.0f }, ab{ 0.0f }, bb{ 0.0f };
+			float ax[4]{}, bx[4]{};
+
+			for (auto texel = 0u; texel < 16u; texel++)
+			{
+				const auto b = static_cast<float>(weights[indices[texel]]) / 64.0f;
+				const auto a = 1.0f - b;
+
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+
+				for (auto channel = 0u; channel < 4u; channel++)
+				{
+					ax[channel] += a * pixels[texel][channel];
+					bx[channel] += b * pixels[texel][channel];
+				}
+			}
+
+			const auto determinant = aa * bb - ab * ab;
+			if (std::fabs(determinant) < 1e-6f)
+				return false;
+
+			for (auto channel = 0u; channel < 4u; channel++)
+			{
+				low[channel] = std::clamp((ax[channel] * bb - bx[channel] * ab) / determinant, 0.0f, 255.0f);
+				high[channel] = std::clamp((bx[channel] * aa - ax[channel] * ab) / determinant, 0.0f, 255.0f);
+			}
+
+			return true;
+		}
+
+		// 4x4 RGBA8 texels (row major) into one 16 byte block
+
+		static void encodeBlock(const std::uint8_t pixels[16][4], std::uint8_t out[16])
+		{
+			// Principal axis of the texels by power iteration on their covariance
+
+			float mean[4]{};
+			for (auto texel = 0u; texel < 16u; texel++)
+				for (auto channel = 0u; channel < 4u; channel++)
+					mean[channel] += pixels[texel][channel] / 16.0f;
+
+			float covariance[4][4]{};
+			for (auto texel = 0u; texel < 16u; texel++)
+				for (auto row = 0u; row < 4u; row++)
+					for (auto column = 0u; column < 4u; column++)
+						covariance[row][column] += (pixels[texel][row] - mean[row]) * (pixels[texel][column] - mean[column]);
+
+			float axis[4]{ 1.0f, 1.0f, 1.0f, 1.0f };
+			for (auto iteration = 0u; iteration < 8u; iteration++)
+			{
+				float next[4]{};
+				for (auto row = 0u; row < 4u; row++)
+					for (auto column = 0u; column < 4u; column++)
+						next[row] += covariance[row][column] * axis[column];
+
+				const auto length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+				if (length < 1e-6f)
+					break;
+
+				for (auto channel = 0u; channel < 4u; channel++)
+					axis[channel] = next[channel] / length;
+			}
+
+			// Endpoints at the extremes along it
+
+			auto lowest{ INFINITY }, highest{ -INFINITY };
+			for (auto texel = 0u; texel < 16u; texel++)
+			{
+				auto projected{ 0.0f };
+				for (auto channel = 0u; channel < 4u; channel++)
+					projected += (pixels[texel][channel] - mean[channel]) * axis[channel];
+
+				lowest = std::min(lowest, projected);
+				highest = std::max(highest, projected);
+			}
+
+			float low[4], high[4];
+			for (auto channel = 0u; channel < 4u; channel++)
+			{
+				low[channel] = std::clamp(mean[channel] + axis[channel] * lowest, 0.0f, 255.0f);
+				high[channel] = std::clamp(mean[channel] + axis[channel] * highest, 0.0f, 255.0f);
+			}
+
+			auto lowEndpoint = quantize(low);
+			auto highEndpoint = quantize(high);
+
+			std::uint8_t indices[16];
+			auto error = assign(pixels, lowEndpoint, highEndpoint, indices);
+
+			if (error && refit(pixels, indices, low, high))
+			{
+				const auto refitLow = quantize(low);
+				const auto refitHigh = quantize(high);
+
+				std::uint8_t refitIndices[16];
+				const auto refitError = assign(pixels, refitLow, refitHigh, refitIndices);
+
+				if (refitError < error)
+				{
+					lowEndpoint = refitLow;
+					highEndpoint = refitHigh;
+					std::copy(std::begin(refitIndices), std::end(refitIndices), std::begin(indices));
+				}
+			}
+
+			// The first index drops its top bit, so it has to be under 8: swapping the endpoints flips every index
+
+			if (indices[0] >= 8u)
+			{
+				std::swap(lowEndpoint, highEndpoint);
+				for (auto& index : indices)
+					index = static_cast<std::uint8_t>(15u - index);
+			}
+
+			std::fill(out, out + 16, std::uint8_t{ 0u });
+
+			BlockWriter writer{ out };
+			writer.write(1u << 6u, 7u); // Mode 6
+
+			for (auto channel = 0u; channel < 4u; channel++)
+			{
+				writer.write(lowEndpoint.channels[channel], 7u);
+				writer.write(highEndpoint.channels[channel], 7u);
+			}
+
+			writer.write(lowEndpoint.pbit, 1u);
+			writer.write(highEndpoint.pbit, 1u);
+
+			writer.write(indices[0], 3u);
+			for (auto texel = 1u; texel < 16u; texel++)
+				writer.write(indices[texel], 4u);
+		}
+
+		// Whole RGBA8 image, edge blocks repeat the last row / column. out holds ((width + 3) / 4) * ((height + 3) / 4) blocks, row major
+
+		static void encodeRows(const std::uint8_t* pixels, std::uint32_t width, std::uint32_t height, std::uint32_t firstRow, std::uint32_t lastRow, std::uint8_t* out)
+		{
+			const auto blocksWide = (width + 3u) / 4u;
+
+			for (auto blockRow = firstRow; blockRow < lastRow; blockRow++)
+			{
+				for (auto blockColumn = 0u; blockColumn < blocksWide; blockColumn++)
+				{
+					std::uint8_t texels[16][4];
+
+					for (auto y = 0u; y < 4u; y++)
+					{
+						for (auto x = 0u; x < 4u; x++)
+						{
+							const auto sourceX = std::min(blockColumn * 4u + x, width - 1u);
+							const auto sourceY = std::min(blockRow * 4u + y, height - 1u);
+							std::copy_n(pixels + (static_cast<std::size_t>(sourceY) * width + sourceX) * 4u, 4u, texels[y * 4u + x]);
+						}
+					}
+
+					encodeBlock(texels, out + (static_cast<std::size_t>(blockRow) * blocksWide + blockColumn) * 16u);
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,179 @@
+/*
+*	Desc: Texture converter
+*	Note: Turns PNGs (anything stb reads) into BC7 KTX2 files with their full mip chain, so the engine can stage them without decoding
+*/
+#pragma once
+#include <array>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+
+#include "../core/scheduler/parallel.hpp"
+#include "../core/rendering/engines/vulkan/memory/ktx2.hpp"
+#include "../utilities/console/logger.hpp"
+#include "bc7.hpp"
+
+#undef min
+#undef max
+
+namespace tools
+{
+	namespace convert
+	{
+		constexpr std::uint32_t bc7SrgbFormat{ VK_FORMAT_BC7_SRGB_BLOCK };
+		constexpr std::uint32_t dfdSize{ 44u };
+
+		// Basic data format descriptor for BC7 sRGB, one 128 bit sample covering the whole block
+
+		static auto bc7Descriptor()
+		{
+			std::array<std::uint8_t, dfdSize> descriptor{};
+
+			const auto put32 = [&](std::size_t offset, std::uint32_t value) {
+				std::memcpy(descriptor.data() + offset, &value, sizeof(value));
+			};
+
+			put32(0u, dfdSize);
+			put32(4u, 0u); // Khronos vendor, basic descriptor type
+			put32(8u, 2u | ((dfdSize - 4u) << 16u)); // Version 2, block size
+
+			descriptor[12] = 134u; // KHR_DF_MODEL_BC7
+			descriptor[13] = 1u; // BT.709 primaries
+			descriptor[14] = 2u; // sRGB transfer
+			descriptor[16] = 3u; // 4x4 texels (stored minus one)
+			descriptor[17] = 3u;
+			descriptor[20] = 16u; // Bytes in plane 0
+
+			descriptor[30] = 127u; // Sample bit length (minus one), offset 0, channel 0 is the BC7 data
+			put32(40u, 0xFFFFFFFFu); // Sample upper, lower stays 0
+
+			return descriptor;
+		}
+
+		// One texture, levels are encoded on the pool a row of blocks at a time
+
+		static bool convertTexture(zkelp::worker_pool_t* pool, const std::string& path)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels)
+			{
+				logger.log("convert | %s failed to load (%s)\n", path.c_str(), stbi_failure_reason());
+				return false;
+			}
+
+			const auto levelCount = vulkan::decode::mipLevelCount(static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height));
+
+			std::vector<std::vector<std::uint8_t>> levels(levelCount);
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> extents(levelCount);
+
+			levels[0].assign(pixels, pixels + static_cast<std::size_t>(width) * height * 4u);
+			extents[0] = { static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height) };
+			stbi_image_free(pixels);
+
+			for (auto level = 1u; level < levelCount; level++)
+			{
+				const auto [aboveWidth, aboveHeight] = extents[level - 1u];
+				extents[level] = { std::max(aboveWidth / 2u, 1u), std::max(aboveHeight / 2u, 1u) };
+
+				levels[level].resize(static_cast<std::size_t>(extents[level].first) * extents[level].second * 4u);
+				vulkan::decode::downsample(levels[level - 1u].data(), aboveWidth, aboveHeight, levels[level].data());
+			}
+
+			std::vector<std::vector<std::uint8_t>> blocks(levelCount);
+			std::size_t uncompressed{ 0u }, compressed{ 0u };
+
+			for (auto level = 0u; level < levelCount; level++)
+			{
+				const auto [levelWidth, levelHeight] = extents[level];
+				const auto blockRows = (levelHeight + 3u) / 4u;
+
+				blocks[level].resize(static_cast<std::size_t>((levelWidth + 3u) / 4u) * blockRows * 16u);
+
+				zkelp::parallel::parallel_for(pool, 0u, blockRows, 1u, [&](std::size_t begin, std::size_t end) {
+					bc7::encodeRows(levels[level].data(), levelWidth, levelHeight, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), blocks[level].data());
+				});
+
+				uncompressed += levels[level].size();
+				compressed += blocks[level].size();
+			}
+
+			// Header, level index, descriptor, then the levels smallest first (each on a 16 byte boundary)
+
+			vulkan::ktx2::Header header{};
+			std::copy(vulkan::ktx2::identifier.begin(), vulkan::ktx2::identifier.end(), header.identifier);
+			header.vkFormat = bc7SrgbFormat;
+			header.typeSize = 1u;
+			header.pixelWidth = static_cast<std::uint32_t>(width);
+			header.pixelHeight = static_cast<std::uint32_t>(height);
+			header.faceCount = 1u;
+			header.levelCount = levelCount;
+			header.dfdByteOffset = static_cast<std::uint32_t>(sizeof(vulkan::ktx2::Header) + sizeof(vulkan::ktx2::LevelIndex) * levelCount);
+			header.dfdByteLength = dfdSize;
+
+			std::vector<vulkan::ktx2::LevelIndex> index(levelCount);
+			auto offset = static_cast<std::uint64_t>(header.dfdByteOffset + dfdSize);
+
+			for (auto level = levelCount; level-- > 0u;)
+			{
+				offset = (offset + 15u) / 16u * 16u;
+				index[level] = { offset, blocks[level].size(), blocks[level].size() };
+				offset += blocks[level].size();
+			}
+
+			const auto outputPath = std::filesystem::path(path).replace_extension(".ktx2");
+
+			std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+			if (!output)
+			{
+				logger.log("convert | cannot write %s\n", outputPath.string().c_str());
+				return false;
+			}
+
+			const auto descriptor = bc7Descriptor();
+
+			output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			output.write(reinterpret_cast<const char*>(index.data()), sizeof(vulkan::ktx2::LevelIndex) * index.size());
+			output.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size());
+
+			for (auto level = levelCount; level-- > 0u;)
+			{
+				const auto padding = static_cast<std::size_t>(index[level].byteOffset) - static_cast<std::size_t>(output.tellp());
+				output.write("\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", padding);
+				output.write(reinterpret_cast<const char*>(blocks[level].data()), blocks[level].size());
+			}
+
+			if (!output)
+			{
+				logger.log("convert | writing %s failed\n", outputPath.string().c_str());
+				return false;
+			}
+
+			const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			logger.log("convert | %s -> %s | %dx%d, %u levels | %.2fMB RGBA -> %.2fMB BC7 | %.1fms\n", path.c_str(), outputPath.string().c_str(), width, height, levelCount,
+				uncompressed / (1024.0 * 1024.0), compressed / (1024.0 * 1024.0), elapsed);
+			return true;
+		}
+	}
+
+	// Writes <name>.ktx2 next to each input, returns false if any of them failed
+
+	static bool convertTextures(const std::vector<std::string>& paths)
+	{
+		zkelp::worker_pool_t pool(std::max(std::thread::hardware_concurrency(), 2u) - 1u);
+
+		auto converted{ true };
+		for (const auto& path : paths)
+			converted &= convert::convertTexture(&pool, path);
+
+		return converted;
+	}
+}
\ No newline at end of file
@@ -3,12 +3,21 @@
 *	Note: This is a neat wrapper around C++'s file system
 */
 #pragma once
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <typeinfo>
 #include <memory>
+#include <cstdint>
 
 #define BASE_ID const std::type_info &type = typeid(*this)
 #define GET_FILE_TYPE virtual enums::FileTypes getFileType() { return fileType; }
@@ -121,6 +130,84 @@ namespace fs
 
 
 	};
+
+	// Read-only view of a whole file, pages come in as they're touched instead of all being read up front. data is null when it couldn't be mapped
+
+	class MappedFile
+	{
+		const std::uint8_t* view{ nullptr };
+		std::size_t length{ 0u };
+
+#ifdef _WIN32
+		HANDLE file{ INVALID_HANDLE_VALUE };
+		HANDLE mapping{ nullptr };
+#endif
+	public:
+		explicit MappedFile(const std::filesystem::path& path)
+		{
+#ifdef _WIN32
+			file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || !fileSize.QuadPart)
+				return;
+
+			mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+				return;
+
+			view = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			length = view != nullptr ? static_cast<std::size_t>(fileSize.QuadPart) : 0u;
+#else
+			const auto descriptor = open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+				return;
+
+			struct stat status;
+			if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+			{
+				const auto mapped = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+				if (mapped != MAP_FAILED)
+				{
+					view = static_cast<const std::uint8_t*>(mapped);
+					length = static_cast<std::size_t>(status.st_size);
+				}
+			}
+
+			close(descriptor); // The mapping keeps the file alive
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (view != nullptr)
+				UnmapViewOfFile(view);
+			if (mapping != nullptr)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (view != nullptr)
+				munmap(const_cast<std::uint8_t*>(view), length);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		auto data() const
+		{
+			return view;
+		}
+
+		auto size() const
+		{
+			return length;
+		}
+	};
 }
 
 #undef BASE_ID
@@ -5,6 +5,8 @@
 #pragma once
 #include <cstdint>
 #include <array>
+#include <vector>
+#include <filesystem>
 
 namespace utils {
 
@@ -14,11 +16,23 @@ namespace utils {
 	constexpr auto mainContextName{ "ZKELP" };
 
 	static std::array<std::uint32_t, 2> windowInformation = { 640u, 480u }; // (Width, Height)
+	static std::filesystem::path resourcesPath{ "D:\\Projects\\ZKelp\\x64\\Debug\\resources" }; // Shaders & textures, "--resources <dir>" overrides it
+
+	// Scheduler specific
+
+	constexpr auto dumpTaskProfiles{ true }; // Print every task's tick timings when the scheduler shuts down
 
 	// Vulkan specific
 
 	constexpr auto useVulkan{ true };
 	constexpr auto vulkanDbg{ true };
+	constexpr std::uint64_t deviceMemoryBlockSize{ 64ull * 1024ull * 1024ull }; // Device memory is sub-allocated out of blocks this big (smaller on small heaps)
+	constexpr std::uint64_t stagingRingSize{ 32ull * 1024ull * 1024ull }; // Every upload goes through a mapped ring this big, anything bigger gets a buffer of its own
+	static bool precomputedMips{ false }; // Textures take their mips from "<name>.mip1.png", "<name>.mip2.png"... when there, "--precomputed-mips" turns it on
+	constexpr std::uint64_t textureBudget{ 512ull * 1024ull * 1024ull }; // Textures nobody holds a handle to stay cached until all of them together pass this, least recently used go first
+	constexpr std::uint32_t drawsPerSecondary{ 256u }; // Draws per bucket of the draw list, each is a secondary command buffer only recorded again when one of its draws changed
+	static std::filesystem::path pipelineCachePath{ "pipeline.cache" }; // Compiled pipelines are saved here on shutdown & loaded back on startup, only for the same GPU & driver
+	static std::uint32_t framesInFlight{ 2u }; // Frames the CPU may record ahead of the GPU, "--in-flight N" overrides it (headless runs get an offscreen image each)
 	std::vector<const char*> vulkanDebugLayerName = {
 		"VK_LAYER_KHRONOS_validation"
 	};